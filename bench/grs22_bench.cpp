@@ -0,0 +1,218 @@
+// grs22_bench: runs the PSI protocols over loopback on a sweep of parameters, and writes per-phase measurements of both
+// parties (see Instrumentation) as JSON and / or CSV, one record per (configuration, repetition, party, phase).
+//
+// usage: grs22_bench [--json FILE] [--csv FILE] [--recipes spatialhash_tt,spatialhash_concat_tt,xorshare_tt] [--centers 4,16]
+//                    [--points 1000,10000] [--ot iknp,softspoken,silent|all] [--repeat N] [--threads N]
+//
+// every OT backend runs on the same centers and points, and must find the same intersection. with more than one backend, a
+// per-backend summary of OT bytes and time is printed last, to compare them on identical input.
+//
+// with neither --json nor --csv, the CSV goes to stdout. progress lines, of the bench and of the protocols, all go to stderr,
+// so stdout can be redirected to a file as is.
+//
+// bitLength, cellBitLength, L and Lambda are template parameters, so their sweep is the list of compiled configurations
+// in main(). share bytes are the most memory a party's shares took at a time (see Instrumentation::shareBytes); peak RSS is
+// of the whole process (both parties) and is reset before every run.
+#include "protocols/spatialhash_tt.tpp"
+#include "protocols/spatialhash_concat_tt.tpp"
+#include "protocols/xorshare_tt.tpp"
+#include <fstream>
+#include <map>
+#include <numeric>
+#include <optional>
+#include <sstream>
+#include <thread>
+
+namespace {
+    using Point = std::pair<uint64_t, uint64_t>;
+
+    struct Options {
+        std::string jsonPath, csvPath;
+        std::vector<std::string> recipes = { "spatialhash_tt", "spatialhash_concat_tt", "xorshare_tt" };
+        std::vector<uint64_t> centerCounts = { 4, 16 }, pointCounts = { 1000, 10000 };
+        std::vector<OtBackend> otBackends = { OtBackend::Iknp };
+        uint64_t repeat = 3, threadCount = defaultThreadCount();
+    };
+
+    struct Record {
+        std::string recipe;
+        int bitLength, cellBitLength, L, Lambda;
+        uint64_t centers, points;
+        std::string ot;
+        uint64_t repetition, intersection;
+        std::string party, phase;
+        double wallSeconds, cpuSeconds;
+        uint64_t bytes, shareBytes, peakRss;
+    };
+
+    std::vector<std::string> split(const std::string& list) {
+        std::vector<std::string> ret;
+        std::stringstream stream(list);
+        for (std::string item; std::getline(stream, item, ',');) ret.push_back(item);
+        return ret;
+    }
+
+    Options parseOptions(int argc, char** argv) {
+        Options options;
+        for (int i = 1; i + 1 < argc; i += 2) {
+            std::string flag = argv[i], value = argv[i + 1];
+            auto numbers = [&] {
+                std::vector<uint64_t> ret;
+                for (auto& item: split(value)) ret.push_back(std::stoull(item));
+                return ret;
+            };
+            if (flag == "--json") options.jsonPath = value;
+            else if (flag == "--csv") options.csvPath = value;
+            else if (flag == "--recipes") options.recipes = split(value);
+            else if (flag == "--centers") options.centerCounts = numbers();
+            else if (flag == "--points") options.pointCounts = numbers();
+            else if (flag == "--repeat") options.repeat = std::stoull(value);
+            else if (flag == "--threads") options.threadCount = std::stoull(value);
+            else if (flag == "--ot" && value == "all") options.otBackends = availableOtBackends();
+            else if (flag == "--ot") {
+                options.otBackends.clear();
+                for (auto& name: split(value)) {
+                    auto available = availableOtBackends();
+                    auto it = std::find_if(available.begin(), available.end(), [&](OtBackend b) { return otBackendName(b) == name; });
+                    if (it == available.end()) std::cerr << "OT backend " << name << " is not enabled in this libOTe build, skipped." << std::endl;
+                    else options.otBackends.push_back(*it);
+                }
+            } else throw std::invalid_argument("unknown option " + flag);
+        }
+        return options;
+    }
+
+    // centers on distinct rows and distinct columns of a grid of step 4 * radius, as many as fit if count of them do not. they
+    // are thus globally axis disjoint (as xorshare_tt requires) and 4 * radius apart (as spatialhash_concat_tt requires), so
+    // every recipe runs on the same input.
+    std::vector<Point> randomCenters(uint64_t count, uint64_t domainSize, uint64_t radius, std::mt19937_64& rng) {
+        std::vector<uint64_t> rows(domainSize / (4 * radius)), columns(rows.size());
+        std::iota(rows.begin(), rows.end(), 0), std::iota(columns.begin(), columns.end(), 0);
+        std::shuffle(rows.begin(), rows.end(), rng), std::shuffle(columns.begin(), columns.end(), rng);
+        std::vector<Point> ret;
+        for (uint64_t i = 0; i < std::min<uint64_t>(count, rows.size()); ++i) ret.emplace_back(rows[i] * 4 * radius + 2 * radius, columns[i] * 4 * radius + 2 * radius);
+        return ret;
+    }
+
+    std::vector<Point> randomPoints(uint64_t count, uint64_t domainSize, std::mt19937_64& rng) {
+        std::set<Point> ret;
+        count = std::min(count, domainSize * domainSize);
+        while (ret.size() < count) ret.emplace(rng() % domainSize, rng() % domainSize);
+        return std::vector<Point>(ret.begin(), ret.end());
+    }
+
+    // xorshare_tt has no OKVS backend to pick.
+    template<int bitLength, int Lambda, int L, int cellBitLength, typename>
+    using xorshare_recipe = xorshare_tt<bitLength, Lambda, L, cellBitLength>;
+
+    template<template<int, int, int, int, typename> class Recipe, int bitLength, int Lambda, int L, int cellBitLength>
+    void runConfiguration(const std::string& recipe, const Options& options, std::vector<Record>& records) {
+        if (std::find(options.recipes.begin(), options.recipes.end(), recipe) == options.recipes.end()) return;
+        using Protocol = Recipe<bitLength, Lambda, L, cellBitLength, okvs::SizedBandBackend<>>;
+        const uint64_t domainSize = 1ull << bitLength, radius = 1ull << cellBitLength;
+        std::mt19937_64 rng(42);
+
+        for (uint64_t centerCount: options.centerCounts) for (uint64_t pointCount: options.pointCounts)
+        for (uint64_t repetition = 0; repetition < options.repeat; ++repetition) {
+            auto centers = randomCenters(centerCount, domainSize, radius, rng);
+            auto points = randomPoints(pointCount, domainSize, rng);
+            std::optional<std::set<Point>> expected;
+
+            for (OtBackend backend: options.otBackends) {
+                Protocol server, client;
+                for (Protocol* psi: { &server, &client }) psi->setThreadCount(options.threadCount), psi->setOtBackend(backend);
+                resetPeakRss();
+                auto Bob = std::thread([&] { client.SetIntersectionClient(points, "localhost"); });
+                auto intersection = server.SetIntersectionServer(centers, "localhost", radius);
+                Bob.join();
+                uint64_t peakRss = peakRssBytes();
+
+                double serverWall = 0;
+                for (auto [party, psi]: { std::make_pair("server", &server), std::make_pair("client", &client) }) {
+                    for (uint64_t phase = 0; phase < PhaseCount; ++phase) {
+                        auto& stats = psi->instrumentation()[(Phase)phase];
+                        records.push_back({ recipe, bitLength, cellBitLength, L, Lambda, centers.size(), points.size(), otBackendName(backend),
+                                            repetition, intersection.size(), party, phaseName((Phase)phase), stats.wallSeconds, stats.cpuSeconds,
+                                            stats.bytes, psi->instrumentation().shareBytes(), peakRss });
+                        if (psi == &server) serverWall += stats.wallSeconds;
+                    }
+                }
+                std::cerr << recipe << " bitLength=" << bitLength << " cellBitLength=" << cellBitLength << " L=" << L << " Lambda=" << Lambda
+                          << " centers=" << centers.size() << " points=" << points.size() << " ot=" << otBackendName(backend)
+                          << ": " << serverWall * 1000 << " ms, " << server.instrumentation().totalBytes() << " bytes, peak RSS "
+                          << peakRss / 1024 << " kB" << std::endl;
+                if (!expected) expected = intersection;
+                else if (intersection != *expected) throw std::runtime_error("OT backend " + otBackendName(backend) + " changed the intersection");
+            }
+        }
+    }
+
+    // per OT backend, over all runs (each backend ran the same configurations on the same input): the mean bytes and wall time of the server's OT phase, and of the whole run.
+    void printOtSummary(const std::vector<Record>& records) {
+        struct Sum { uint64_t runs = 0, otBytes = 0, bytes = 0; double otSeconds = 0, seconds = 0; };
+        std::map<std::string, Sum> sums;
+        for (auto& r: records) {
+            if (r.party != "server") continue;
+            auto& sum = sums[r.ot];
+            sum.bytes += r.bytes, sum.seconds += r.wallSeconds;
+            if (r.phase == phaseName(Phase::Ot)) sum.runs++, sum.otBytes += r.bytes, sum.otSeconds += r.wallSeconds;
+        }
+        for (auto& [ot, sum]: sums)
+            std::cerr << "OT backend " << ot << ", " << sum.runs << " runs: OT " << sum.otBytes / sum.runs << " bytes, "
+                      << sum.otSeconds * 1000 / sum.runs << " ms; run " << sum.bytes / sum.runs << " bytes, "
+                      << sum.seconds * 1000 / sum.runs << " ms" << std::endl;
+    }
+
+    void writeCsv(const std::string& path, const std::vector<Record>& records) {
+        std::ofstream out(path);
+        out << "recipe,bit_length,cell_bit_length,L,lambda,centers,points,ot,repetition,intersection,party,phase,wall_s,cpu_s,bytes,share_bytes,peak_rss_bytes\n";
+        for (auto& r: records)
+            out << r.recipe << ',' << r.bitLength << ',' << r.cellBitLength << ',' << r.L << ',' << r.Lambda << ',' << r.centers << ','
+                << r.points << ',' << r.ot << ',' << r.repetition << ',' << r.intersection << ',' << r.party << ',' << r.phase << ','
+                << r.wallSeconds << ',' << r.cpuSeconds << ',' << r.bytes << ',' << r.shareBytes << ',' << r.peakRss << '\n';
+    }
+
+    void writeJson(const std::string& path, const std::vector<Record>& records) {
+        std::ofstream out(path);
+        out << "[\n";
+        for (uint64_t i = 0; i < records.size(); ++i) {
+            auto& r = records[i];
+            out << "  {\"recipe\": \"" << r.recipe << "\", \"bit_length\": " << r.bitLength << ", \"cell_bit_length\": " << r.cellBitLength
+                << ", \"L\": " << r.L << ", \"lambda\": " << r.Lambda << ", \"centers\": " << r.centers << ", \"points\": " << r.points
+                << ", \"ot\": \"" << r.ot << "\", \"repetition\": " << r.repetition << ", \"intersection\": " << r.intersection
+                << ", \"party\": \"" << r.party << "\", \"phase\": \"" << r.phase << "\", \"wall_s\": " << r.wallSeconds
+                << ", \"cpu_s\": " << r.cpuSeconds << ", \"bytes\": " << r.bytes << ", \"share_bytes\": " << r.shareBytes
+                << ", \"peak_rss_bytes\": " << r.peakRss << "}"
+                << (i + 1 < records.size() ? ",\n" : "\n");
+        }
+        out << "]\n";
+    }
+}
+
+int main(int argc, char** argv) {
+    Options options = parseOptions(argc, argv);
+    std::vector<Record> records;
+
+    // the compiled sweep: a base point, then one of cellBitLength / bitLength, L and Lambda changed at a time. Lambda does not
+    // matter to xorshare_tt.
+    runConfiguration<spatialhash_tt, 8, 40, 60, 2>("spatialhash_tt", options, records);
+    runConfiguration<spatialhash_tt, 10, 40, 60, 3>("spatialhash_tt", options, records);
+    runConfiguration<spatialhash_tt, 12, 40, 60, 4>("spatialhash_tt", options, records);
+    runConfiguration<spatialhash_tt, 10, 40, 40, 3>("spatialhash_tt", options, records);
+    runConfiguration<spatialhash_tt, 10, 80, 60, 3>("spatialhash_tt", options, records);
+    runConfiguration<spatialhash_concat_tt, 8, 40, 60, 2>("spatialhash_concat_tt", options, records);
+    runConfiguration<spatialhash_concat_tt, 10, 40, 60, 3>("spatialhash_concat_tt", options, records);
+    runConfiguration<spatialhash_concat_tt, 12, 40, 60, 4>("spatialhash_concat_tt", options, records);
+    runConfiguration<spatialhash_concat_tt, 10, 40, 40, 3>("spatialhash_concat_tt", options, records);
+    runConfiguration<spatialhash_concat_tt, 10, 80, 60, 3>("spatialhash_concat_tt", options, records);
+    runConfiguration<xorshare_recipe, 8, 40, 60, 2>("xorshare_tt", options, records);
+    runConfiguration<xorshare_recipe, 10, 40, 60, 3>("xorshare_tt", options, records);
+    runConfiguration<xorshare_recipe, 12, 40, 60, 4>("xorshare_tt", options, records);
+    runConfiguration<xorshare_recipe, 10, 40, 40, 3>("xorshare_tt", options, records);
+
+    if (options.otBackends.size() > 1 && !records.empty()) printOtSummary(records);
+    if (!options.csvPath.empty()) writeCsv(options.csvPath, records);
+    if (!options.jsonPath.empty()) writeJson(options.jsonPath, records);
+    if (options.csvPath.empty() && options.jsonPath.empty()) writeCsv("/dev/stdout", records);
+    return 0;
+}
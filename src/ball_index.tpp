@@ -0,0 +1,65 @@
+#pragma once
+#include "common.tpp"
+#include <vector>
+#include <unordered_map>
+
+// union of L-infinity balls (squares of side 2 * radius + 1) sharing one radius, as held by the server.
+// centers are bucketed on a grid of side 2 * radius + 1, so a point can only be covered by centers in its own bucket or one
+// of the 8 around it, and contains() looks at those only instead of scanning every center.
+class BallIndex {
+public:
+    using Point = std::pair<uint64_t, uint64_t>;
+
+    BallIndex(const std::vector<Point>& centers_, uint64_t radius_): centers(centers_), radius(radius_), side(2 * radius_ + 1) {
+        for (auto& [x, y]: centers) buckets[bucketKey(x / side, y / side)].emplace_back(x, y);
+    }
+
+    // whether (x, y) lies in any of the balls.
+    bool contains(uint64_t x, uint64_t y) const {
+        const uint64_t bx = x / side, by = y / side;
+        for (uint64_t i = (bx ? bx - 1 : 0); i <= bx + 1; ++i) {
+            for (uint64_t j = (by ? by - 1 : 0); j <= by + 1; ++j) {
+                auto it = buckets.find(bucketKey(i, j));
+                if (it == buckets.end()) continue;
+                for (auto [cx, cy]: it->second) {
+                    if (std::max(
+                        std::abs((int64_t)cx - (int64_t)x),
+                        std::abs((int64_t)cy - (int64_t)y)) <= (int64_t)radius) return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    // every point of [0, domainSize)^2 covered by at least one ball, sorted and without duplicates.
+    // each ball is a column interval [cy - r, cy + r] on each of its 2r + 1 rows x; overlapping intervals of the same row are
+    // merged after sorting, so the cost is proportional to the total area of the balls rather than to the domain.
+    std::vector<Point> expand(uint64_t domainSize) const {
+        struct Interval { uint64_t x, low, high; }; // [low, high] on row x
+        const int64_t r = radius, limit = domainSize - 1;
+        std::vector<Interval> intervals;
+        for (auto [cx, cy]: centers) {
+            int64_t low = std::max<int64_t>(0, (int64_t)cy - r), high = std::min<int64_t>(limit, (int64_t)cy + r);
+            if (low > high) continue;
+            for (int64_t x = std::max<int64_t>(0, (int64_t)cx - r); x <= std::min<int64_t>(limit, (int64_t)cx + r); ++x)
+                intervals.push_back(Interval{(uint64_t)x, (uint64_t)low, (uint64_t)high});
+        }
+        std::sort(intervals.begin(), intervals.end(), [](const Interval& a, const Interval& b) {
+            return a.x != b.x ? a.x < b.x : a.low < b.low;
+        });
+
+        std::vector<Point> ret;
+        for (uint64_t i = 0; i < intervals.size();) {
+            uint64_t x = intervals[i].x, low = intervals[i].low, high = intervals[i].high;
+            for (++i; i < intervals.size() && intervals[i].x == x && intervals[i].low <= high + 1; ++i) high = std::max(high, intervals[i].high);
+            for (uint64_t y = low; y <= high; ++y) ret.emplace_back(x, y);
+        }
+        return ret;
+    }
+private:
+    static uint64_t bucketKey(uint64_t bx, uint64_t by) { return (bx << 32) | by; }
+
+    std::vector<Point> centers;
+    uint64_t radius, side;
+    std::unordered_map<uint64_t, std::vector<Point>> buckets;
+};
@@ -0,0 +1,74 @@
+#pragma once
+#include "../common.tpp"
+#include "../bit_buffer.tpp"
+#include "../thread_pool.tpp"
+#include <functional>
+#include <memory>
+#include <stdexcept>
+
+// builds and encodes the L independent repetitions (pairs of spatial hashes h0, h1) that the server sends via OT.
+// each repetition needs two full OKVS encodes, so the repetitions are spread over a pool of threadCount threads.
+// every task draws its randomness from its own PRNG stream, seeded from a master seed, so no random source is shared
+// between threads and the result for a given master seed does not depend on the number of threads.
+template<typename SuitableSpatialHash, uint64_t L>
+class ParallelEncoder {
+public:
+    using Share = typename SuitableSpatialHash::Share;
+    using SharePair = std::pair<Share, Share>;
+    // on the heap: a fixed size share is a std::bitset, and L pairs of them easily outgrow a stack.
+    using SharePairs = std::vector<SharePair>;
+
+    // runtime sized shares take their storage from arena if given (see ShareArena), from the heap otherwise.
+    ParallelEncoder(uint64_t threadCount_ = defaultThreadCount(), ShareArena* arena_ = nullptr): threadCount(threadCount_), arena(arena_) {}
+
+    // build(trial, rng, h0, h1) inserts the cells of repetition `trial` into h0 and h1, using rng for the secret sharing.
+    // onDone(trial, pair) is called from the worker thread as soon as both shares of repetition `trial` are encoded, so they
+    // can be sent while the other repetitions still encode. the pair lives in its task only (on the heap, as a fixed size share
+    // may be large) and is dropped once onDone returns, unless onDone moves it out. a repetition is built, encoded and handed to
+    // onDone by one task, so at most threadCount repetitions are held at a time besides the ones onDone keeps, whatever the
+    // share type.
+    template<typename Build>
+    void encodeEach(Build&& build, uint64_t masterSeed, const std::function<void(uint64_t, SharePair&)>& onDone) {
+        std::mt19937_64 seeder(masterSeed);
+        std::array<uint64_t, 3 * L> seeds; // one stream per build, two per repetition's encodes
+        for (auto& seed: seeds) seed = seeder();
+
+        parallelFor(L, threadCount, [&](uint64_t trial) {
+            std::mt19937_64 rng(seeds[trial]);
+            SuitableSpatialHash h0, h1;
+            build(trial, rng, h0, h1);
+            // the two shares of a representation of entire set of Alice.
+            auto pair = std::make_unique<SharePair>();
+            encodeInto(h0, seeds[L + 2 * trial], pair->first);
+            encodeInto(h1, seeds[L + 2 * trial + 1], pair->second);
+            onDone(trial, *pair);
+        });
+    }
+
+    template<typename Build>
+    void encodeEach(Build&& build, const std::function<void(uint64_t, SharePair&)>& onDone) {
+        std::random_device dev;
+        encodeEach(std::forward<Build>(build), ((uint64_t)dev() << 32) | dev(), onDone);
+    }
+
+    // same, keeping all L repetitions: they are moved into `shares`, resized to L.
+    template<typename Build>
+    void encode(SharePairs& shares, Build&& build, uint64_t masterSeed) {
+        shares.resize(L);
+        encodeEach(std::forward<Build>(build), masterSeed, [&](uint64_t trial, SharePair& pair) { shares[trial] = std::move(pair); });
+    }
+
+    template<typename Build>
+    void encode(SharePairs& shares, Build&& build) {
+        std::random_device dev;
+        encode(shares, std::forward<Build>(build), ((uint64_t)dev() << 32) | dev());
+    }
+private:
+    void encodeInto(SuitableSpatialHash& hash, uint64_t seed, Share& share) {
+        if constexpr (!SuitableSpatialHash::FixedOutputSize) share = Share(SuitableSpatialHash::getOutputSize(hash.size()), arena);
+        if (!hash.encode(seed, share)) throw std::runtime_error("OKVS encoding failed after all attempts");
+    }
+
+    uint64_t threadCount;
+    ShareArena* arena;
+};
@@ -5,16 +5,19 @@
 #include "dbg.h"
 // a spatial hash is something that takes 2D (non-negative) integer coordinates, and obliviously return bitstrings (usually bFSS half-shares).
 // this class does not take care of smaller construction, you have to supply serialised sub-bFSS to it. 
-template<uint64_t KeyBitLength, uint64_t ValueLength, uint64_t Lambda>
+// OkvsBackend selects the underlying OKVS, see okvs::DenseBackend and okvs::BandBackend.
+template<uint64_t KeyBitLength, uint64_t ValueLength, uint64_t Lambda, typename OkvsBackend = okvs::DenseBackend>
 struct SpatialHash {
 public:
     const static uint64_t KeyLength = 2 * KeyBitLength; // recall we have two keys: X and Y
-    const static uint64_t OutputSize = ValueLength * (KeyLength + Lambda) + Lambda; // this is the calculated length of final output
     using SerialisedKey = std::bitset<KeyLength>; 
     using Value = std::bitset<ValueLength>;
 
     // instantiate okvs with our required parameters
-    using SuitableOkvs = okvs::RandomBooleanPaXoS<KeyLength, ValueLength, Lambda>;
+    using SuitableOkvs = typename OkvsBackend::template Okvs<KeyLength, ValueLength, Lambda>;
+    const static bool FixedOutputSize = SuitableOkvs::FixedSize; // false if share length depends on number of inserted cells
+    const static uint64_t OutputSize = SuitableOkvs::SerialisedLength; // this is the calculated length of final output, if fixed
+    using Share = SuitableOkvs::Serialised; // std::bitset<OutputSize> if fixed, BitBuffer otherwise
 
     using EncodedPaXoS = SuitableOkvs::EncodedPaXoS;
     using Nonce = SuitableOkvs::Nonce;
@@ -28,9 +31,14 @@ public:
         kvs[serialize(x, y)] = value;
     }
     
-    std::optional<std::bitset<OutputSize>> encode() {
-        auto randomSource = std::make_unique<std::random_device>();
-        SuitableOkvs okvs(std::move(randomSource));
+    std::optional<Share> encode() {
+        std::random_device dev;
+        return encode(((uint64_t)dev() << 32) | dev());
+    }
+
+    // encodes with OKVS randomness drawn from given seed, so that parallel encoders need not share a random source.
+    std::optional<Share> encode(uint64_t seed) {
+        SuitableOkvs okvs(seed);
 
         std::vector<std::pair<SerialisedKey, Value>> kvs_;
         std::copy(kvs.begin(), kvs.end(), std::back_inserter(kvs_));
@@ -38,24 +46,64 @@ public:
         return okvs.serialize(okvs.encode(kvs_));
     }
 
-    // as decoder, we wish to decode;
-    Value decode(const std::bitset<OutputSize>& str, uint32_t x, uint32_t y) {
-        auto randomSource = std::make_unique<std::random_device>();
-        SuitableOkvs okvs(std::move(randomSource));
-        auto [paxos, nonce] = okvs.deserialize(str);
+    // same, into out: a BitBuffer share of getOutputSize(size()) bits is written in place, so its storage is kept.
+    // returns false if encoding failed.
+    bool encode(uint64_t seed, Share& out) {
+        SuitableOkvs okvs(seed);
+
+        std::vector<std::pair<SerialisedKey, Value>> kvs_;
+        std::copy(kvs.begin(), kvs.end(), std::back_inserter(kvs_));
+
+        return okvs.serialize(okvs.encode(kvs_), out);
+    }
 
-        return okvs.decode(paxos, nonce, serialize(x, y));
+    // as decoder, we wish to decode; deserialises the whole share, so use Decoder when decoding more than one cell.
+    Value decode(const Share& str, uint32_t x, uint32_t y) {
+        return Decoder(str).decode(x, y);
     }
 
+    // decode-ready form of one share: deserialised once, then any number of cells can be looked up from it.
+    class Decoder {
+    public:
+        Decoder(const Share& str): okvs(0) { // decoding needs no randomness
+            std::tie(paxos, nonce) = okvs.deserialize(str);
+        }
+
+        Value decode(uint32_t x, uint32_t y) const {
+            return okvs.decode(paxos, nonce, serialize(x, y));
+        }
+
+        // out[i] = decode(cells[i]), with keys hashed in one batch.
+        void decodeBatch(const std::vector<std::pair<uint32_t, uint32_t>>& cells, std::vector<Value>& out) const {
+            std::vector<SerialisedKey> keys(cells.size());
+            for (uint64_t i = 0; i < cells.size(); ++i) keys[i] = serialize(cells[i].first, cells[i].second);
+            okvs.decodeBatch(paxos, nonce, keys, out);
+        }
+    private:
+        SuitableOkvs okvs;
+        EncodedPaXoS paxos;
+        Nonce nonce;
+    };
+
     constexpr static size_t getOutputSize() {
+        static_assert(FixedOutputSize, "share length depends on number of cells, use getOutputSize(cellCount)");
         return OutputSize;
     }
+
+    // length of share holding cellCount occupied cells. works for any backend.
+    constexpr static size_t getOutputSize(uint64_t cellCount) {
+        return SuitableOkvs::serialisedLengthFor(cellCount);
+    }
+
+    uint64_t size() const {
+        return kvs.size();
+    }
 protected:
-    SerialisedKey serialize(uint32_t x, uint32_t y) {
-        uint32_t maskLastKBit = (1 << KeyBitLength) - 1;
-        uint32_t cleanX = maskLastKBit & x;
-        uint32_t cleanY = maskLastKBit & y;
-        uint32_t concat = (cleanX << KeyBitLength) | cleanY; // concat two ints together
+    static SerialisedKey serialize(uint32_t x, uint32_t y) {
+        uint64_t maskLastKBit = (1ull << KeyBitLength) - 1;
+        uint64_t cleanX = maskLastKBit & x;
+        uint64_t cleanY = maskLastKBit & y;
+        uint64_t concat = (cleanX << KeyBitLength) | cleanY; // concat two ints together, in 64 bits as KeyLength may exceed 32
         SerialisedKey key(concat);
 
         return key;
@@ -23,6 +23,10 @@ public:
     SecretPair encode(const std::vector<std::pair<Key, Value>>& data) {
         std::random_device dev;
         std::mt19937_64 rng(dev());
+        return encode(data, rng);
+    };
+    // same as above, drawing the secret sharing pad from given PRNG.
+    SecretPair encode(const std::vector<std::pair<Key, Value>>& data, std::mt19937_64& rng) {
         // generate enough randomness for secret sharing, and fill onto secret shares
         auto pad = GetBitSequenceFromPRNG<ShareLength>(rng); 
         
@@ -42,10 +46,14 @@ public:
     // for evaluator
     TruthTable(const SecretShare& share_): BaseType(share_) {};
     Value evaluate(const Key& key) {
+        return evaluate(this->share, key);
+    };
+    // evaluates a share in place, without copying it into a TruthTable first.
+    static Value evaluate(const SecretShare& share, const Key& key) {
         Value ret;
         for (uint64_t currBit = 0; currBit < ValueLength; ++currBit) {
             uint64_t offset = key * ValueLength + currBit;
-            ret[currBit] = this->share[offset]; 
+            ret[currBit] = share[offset]; 
         }
         return ret;
     };
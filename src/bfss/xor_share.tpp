@@ -2,52 +2,97 @@
 
 #include "common.tpp"
 #include "bfss/bfss.tpp"
+#include "bfss/trivial_bfss.tpp"
+#include <stdexcept>
 
-// xor-share bFSS as described in paper. This works iff the balls are "globally axis disjoint" i.e. the projection of spheres onto any of d axis are disjoint.
-// specifically, we set the value length to ValueLength, so that this is (1 - 2 ^ {-V}, 1)-bFSS.
-// the key type is uint64_t instead of bitset, since we are dealing with axis here, 64 bit should be more than enough.
-template<uint64_t KeyLength, int ValueLength>
-class XorSharebFSS: bFSS<uint64_t, std::bitset<1>, (1ull << KeyLength) * ValueLength> {
+// xor-share bFSS as described in paper, over 2 axes with a truth table (tt) per axis: f(x, y) = f_X(x) ^ f_Y(y), and a share is
+// the tt share of f_X concatenated with the tt share of f_Y. so no OKVS is involved, and a share is 2 * 2 ^ KeyLength * ValueLength bits.
+// This works iff the function is specified on a "globally axis disjoint" set, i.e. a union of products X_i x Y_i whose projections
+// onto any of the 2 axes are disjoint: f_X is a random r_i on X_i and f_Y is r_i ^ value on Y_i, so f is value on X_i x Y_i.
+// everywhere else f_X and f_Y are random, so f is uniform outside, making this a (1 - 2 ^ {-V}, 1)-bFSS with V = ValueLength.
+// the key type is a pair of uint64_t (one per axis), since we are dealing with axis here, 64 bit should be more than enough.
+template<uint64_t KeyLength, uint64_t ValueLength>
+class XorSharebFSS: bFSS<std::pair<uint64_t, uint64_t>, std::bitset<ValueLength>, 2 * (1ull << KeyLength) * ValueLength> {
 public:
-    using BaseType = bFSS<uint64_t, std::bitset<1>, (1ull << KeyLength) * ValueLength>; 
-    const static uint64_t ShareLength = (1ull << KeyLength) * ValueLength;
+    using BaseType = bFSS<std::pair<uint64_t, uint64_t>, std::bitset<ValueLength>, 2 * (1ull << KeyLength) * ValueLength>;
+    using AxisTable = TruthTable<KeyLength, ValueLength>;
+    const static uint64_t AxisShareLength = AxisTable::ShareLength;
+    const static uint64_t ShareLength = 2 * AxisShareLength;
     using SecretShare = BaseType::SecretShare;
     using SecretPair = BaseType::SecretPair;
-    using Key = uint64_t; 
+    using Key = std::pair<uint64_t, uint64_t>;
     using Value = std::bitset<ValueLength>;
-    // for encoder 
-    TruthTable() {
+    // X_i x Y_i, coordinates of each axis listed once.
+    using Product = std::pair<std::vector<uint64_t>, std::vector<uint64_t>>;
+
+    // for encoder
+    XorSharebFSS() {
         static_assert(KeyLength <= 32);
     };
-    ~TruthTable() {};
+    ~XorSharebFSS() {};
+    // keys must have pairwise distinct X and pairwise distinct Y coordinates, see encodeProducts.
     SecretPair encode(const std::vector<std::pair<Key, Value>>& data) {
         std::random_device dev;
         std::mt19937_64 rng(dev());
-        // generate enough randomness for secret sharing, and fill onto secret shares
-        auto pad = GetBitSequenceFromPRNG<ShareLength>(rng); 
-        
-        // nonspecified keys will evaluate to all 1s by default 
-        // why? this is for convenience of encoding set membership, as nonzero means "not in set" using notation in paper
-        SecretPair ret(pad, ~pad);
-
-        // now XOR the values into pad; 
-        for (const auto& [Key, Value]: data) {
-            for (uint64_t currBit = 0; currBit < 1; ++currBit) {
-                uint64_t offset = Key * 1 + currBit;
-                ret.second[offset] = ret.first[offset] ^ Value[currBit];
-            }
+        return encode(data, rng);
+    };
+    // same as above, drawing randomness from given PRNG.
+    SecretPair encode(const std::vector<std::pair<Key, Value>>& data, std::mt19937_64& rng) {
+        std::vector<Product> products;
+        std::vector<Value> values;
+        for (const auto& [key, value]: data) {
+            products.push_back({ { key.first }, { key.second } });
+            values.push_back(value);
         }
-        return ret;
+        return encode(products, values, rng);
     };
+    // f is 0 on every X_i x Y_i (recall zero means inside, as described in paper), and random elsewhere.
+    // throws std::invalid_argument if the products are not globally axis disjoint, or leave the domain.
+    SecretPair encodeProducts(const std::vector<Product>& products, std::mt19937_64& rng) {
+        return encode(products, std::vector<Value>(products.size()), rng);
+    }
+
     // for evaluator
-    TruthTable(const SecretShare& share_): BaseType(share_) {};
+    XorSharebFSS(const SecretShare& share_): BaseType(share_) {};
     Value evaluate(const Key& key) {
+        return evaluate(this->share, key);
+    };
+    // evaluates a share in place, without copying it into a XorSharebFSS first.
+    // throws std::out_of_range if a coordinate of key leaves the domain, as it would index past its axis table.
+    static Value evaluate(const SecretShare& share, const Key& key) {
+        if (key.first >> KeyLength || key.second >> KeyLength) throw std::out_of_range("key out of the domain of xor-share");
         Value ret;
-        for (uint64_t currBit = 0; currBit < 1; ++currBit) {
-            uint64_t offset = key * 1 + currBit;
-            ret[currBit] = this->share[offset]; 
-        }
+        for (uint64_t currBit = 0; currBit < ValueLength; ++currBit)
+            ret[currBit] = share[key.first * ValueLength + currBit] ^ share[AxisShareLength + key.second * ValueLength + currBit];
         return ret;
     };
-};
+private:
+    SecretPair encode(const std::vector<Product>& products, const std::vector<Value>& values, std::mt19937_64& rng) {
+        const uint64_t domainSize = 1ull << KeyLength;
+        // f_X and f_Y over the whole axis, so that no key is left to tt's default of all 1s.
+        std::vector<std::pair<uint64_t, Value>> axis[2];
+        for (auto& table: axis) {
+            table.resize(domainSize);
+            for (uint64_t k = 0; k < domainSize; ++k) table[k] = { k, GetBitSequenceFromPRNG<ValueLength>(rng) };
+        }
 
+        std::vector<bool> used[2] = { std::vector<bool>(domainSize), std::vector<bool>(domainSize) };
+        for (uint64_t i = 0; i < products.size(); ++i) {
+            const Value r = GetBitSequenceFromPRNG<ValueLength>(rng);
+            const std::vector<uint64_t>* coordinates[2] = { &products[i].first, &products[i].second };
+            for (uint64_t dim = 0; dim < 2; ++dim) {
+                for (uint64_t k: *coordinates[dim]) {
+                    if (k >= domainSize) throw std::invalid_argument("coordinate out of the domain of xor-share");
+                    if (used[dim][k]) throw std::invalid_argument("xor-share needs a globally axis disjoint set");
+                    used[dim][k] = true;
+                    axis[dim][k].second = dim ? r ^ values[i] : r;
+                }
+            }
+        }
+
+        AxisTable tt;
+        auto [x0, x1] = tt.encode(axis[0], rng);
+        auto [y0, y1] = tt.encode(axis[1], rng);
+        return SecretPair(concatBitSet(x0, y0), concatBitSet(x1, y1));
+    }
+};
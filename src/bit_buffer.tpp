@@ -0,0 +1,176 @@
+#pragma once
+#include "common.tpp"
+#include <vector>
+#include <cstring>
+#include <bit>
+#include <mutex>
+#include <new>
+#include <utility>
+
+// word-level access to bit strings. everything below assumes bit i of a bit string lives in word i / 64 at position
+// i % 64 (little endian words), which is how libstdc++ lays out std::bitset, how BitBuffer stores its bits and how libOTe
+// reads a block as two uint64_t. conversions between them are therefore plain word copies.
+static_assert(std::endian::native == std::endian::little);
+
+// words backing a std::bitset. relies on libstdc++ storing exactly ceil(N / 64) unsigned longs and nothing else.
+// bits past N in the last word must stay 0, as bitset's count(), == etc. rely on that.
+template<size_t N>
+uint64_t* bitsetWords(std::bitset<N>& x) {
+    static_assert(N == 0 || sizeof(std::bitset<N>) == sizeof(uint64_t) * ((N + 63) / 64));
+    return reinterpret_cast<uint64_t*>(&x);
+}
+
+template<size_t N>
+const uint64_t* bitsetWords(const std::bitset<N>& x) {
+    return bitsetWords(const_cast<std::bitset<N>&>(x));
+}
+
+// reads count <= 64 bits starting at bit offset, without touching words that hold none of them.
+inline uint64_t readBits(const uint64_t* src, uint64_t offset, uint64_t count) {
+    uint64_t word = offset / 64, shift = offset % 64;
+    uint64_t ret = src[word] >> shift;
+    if (shift && shift + count > 64) ret |= src[word + 1] << (64 - shift);
+    return count == 64 ? ret : ret & ((1ull << count) - 1);
+}
+
+// copies bits [srcOffset, srcOffset + count) of src into [dstOffset, dstOffset + count) of dst, one word at a time.
+// other bits of dst are left as is. whole words are memcpy'd when both offsets are word aligned.
+inline void copyBits(const uint64_t* src, uint64_t srcOffset, uint64_t* dst, uint64_t dstOffset, uint64_t count) {
+    if (srcOffset % 64 == 0 && dstOffset % 64 == 0) {
+        std::memcpy(dst + dstOffset / 64, src + srcOffset / 64, count / 64 * sizeof(uint64_t));
+        srcOffset += count / 64 * 64, dstOffset += count / 64 * 64, count %= 64;
+    }
+    while (count) {
+        uint64_t shift = dstOffset % 64;
+        uint64_t step = std::min(count, 64 - shift);
+        uint64_t mask = (step == 64 ? ~0ull : (1ull << step) - 1) << shift;
+        uint64_t& word = dst[dstOffset / 64];
+        word = (word & ~mask) | (readBits(src, srcOffset, step) << shift);
+        srcOffset += step, dstOffset += step, count -= step;
+    }
+}
+
+// one contiguous, cache line aligned allocation cut into slotCount equal slots, each holding the words of one share.
+// shares of a run all have the same length, so a slot freed by one share is taken by the next: a run that holds at most
+// slotCount shares at a time allocates nothing else for them, and never more than capacityBytes(). acquire() throws
+// std::bad_alloc instead of growing. thread safe.
+class ShareArena {
+public:
+    static constexpr uint64_t Alignment = 64; // a cache line, and a multiple of libOTe's 16-byte blocks
+
+    ShareArena(uint64_t slotBits, uint64_t slotCount_)
+        : slotWords(slotBytesFor(slotBits) / sizeof(uint64_t)), slotCount(slotCount_),
+          memory(static_cast<uint64_t*>(::operator new(std::max<uint64_t>(1, slotWords * slotCount) * sizeof(uint64_t), std::align_val_t(Alignment)))) {
+        for (uint64_t slot = slotCount; slot--;) freeSlots.push_back(slot);
+    }
+    ~ShareArena() { ::operator delete(memory, std::align_val_t(Alignment)); }
+    ShareArena(const ShareArena&) = delete;
+    ShareArena& operator=(const ShareArena&) = delete;
+
+    // words of a free slot, for wordCount <= slotWords words. contents are left as they are.
+    uint64_t* acquire(uint64_t wordCount) {
+        std::lock_guard<std::mutex> guard(lock);
+        if (wordCount > slotWords || freeSlots.empty()) throw std::bad_alloc();
+        uint64_t slot = freeSlots.back();
+        freeSlots.pop_back();
+        peakSlots = std::max(peakSlots, slotCount - freeSlots.size());
+        return memory + slot * slotWords;
+    }
+
+    void release(uint64_t* words) {
+        std::lock_guard<std::mutex> guard(lock);
+        freeSlots.push_back((words - memory) / slotWords);
+    }
+
+    // a slot for slotBits bits, rounded up to whole cache lines.
+    static uint64_t slotBytesFor(uint64_t slotBits) { return (slotBits + 8 * Alignment - 1) / (8 * Alignment) * Alignment; }
+    uint64_t slotBytes() const { return slotWords * sizeof(uint64_t); }
+    uint64_t capacityBytes() const { return slotCount * slotBytes(); }
+    // most bytes held by shares at one time.
+    uint64_t peakBytes() {
+        std::lock_guard<std::mutex> guard(lock);
+        return peakSlots * slotBytes();
+    }
+private:
+    uint64_t slotWords, slotCount, peakSlots = 0;
+    uint64_t* memory;
+    std::vector<uint64_t> freeSlots;
+    std::mutex lock;
+};
+
+// runtime-sized bit string, for shares whose length is only known after encoding (e.g. OKVS sized to number of keys).
+// bit i lives in words[i / 64] at position i % 64, i.e. same order as std::bitset; bits past size() are kept at 0.
+// storage is padded to a whole number of 128-bit blocks and cache line aligned, so it can be viewed as libOTe blocks
+// directly. it comes from an arena if one is given (see ShareArena), from the heap otherwise. moving a BitBuffer hands its
+// storage over; a copy always goes to the heap.
+class BitBuffer {
+public:
+    BitBuffer() = default;
+    explicit BitBuffer(uint64_t bitLength, ShareArena* arena_ = nullptr): length(bitLength), blocks((bitLength + 127) / 128), arena(arena_) {
+        if (!blocks) return;
+        words = arena ? arena->acquire(2 * blocks)
+                      : static_cast<uint64_t*>(::operator new(blocks * 16, std::align_val_t(ShareArena::Alignment)));
+        std::memset(words, 0, blocks * 16);
+    }
+
+    BitBuffer(const BitBuffer& other): BitBuffer(other.length) {
+        if (blocks) std::memcpy(words, other.words, blocks * 16);
+    }
+    BitBuffer(BitBuffer&& other) noexcept
+        : length(std::exchange(other.length, 0)), blocks(std::exchange(other.blocks, 0)),
+          words(std::exchange(other.words, nullptr)), arena(std::exchange(other.arena, nullptr)) {}
+    BitBuffer& operator=(BitBuffer other) noexcept {
+        std::swap(length, other.length), std::swap(blocks, other.blocks);
+        std::swap(words, other.words), std::swap(arena, other.arena);
+        return *this;
+    }
+    ~BitBuffer() {
+        if (!words) return;
+        if (arena) arena->release(words);
+        else ::operator delete(words, std::align_val_t(ShareArena::Alignment));
+    }
+
+    uint64_t size() const { return length; }
+    uint64_t wordCount() const { return (length + 63) / 64; }
+    uint64_t blockCount() const { return blocks; }
+    uint64_t* data() { return words; }
+    const uint64_t* data() const { return words; }
+
+    bool operator[](uint64_t idx) const {
+        return (words[idx / 64] >> (idx % 64)) & 1;
+    }
+    void set(uint64_t idx, bool value) {
+        if (value) words[idx / 64] |= (1ull << (idx % 64));
+        else words[idx / 64] &= ~(1ull << (idx % 64));
+    }
+
+    // copies bits into [offset, offset + N).
+    template<size_t N>
+    void write(uint64_t offset, const std::bitset<N>& bits) {
+        assert(offset + N <= length);
+        copyBits(bitsetWords(bits), 0, words, offset, N);
+    }
+
+    // reads bits [offset, offset + N) into a bitset.
+    template<size_t N>
+    std::bitset<N> read(uint64_t offset) const {
+        assert(offset + N <= length);
+        std::bitset<N> ret;
+        copyBits(words, offset, bitsetWords(ret), 0, N);
+        return ret;
+    }
+
+    // clears bits past size(), e.g. after the words were overwritten wholesale through data().
+    void clearPadding() {
+        if (length % 64) words[length / 64] &= (1ull << (length % 64)) - 1;
+        for (uint64_t w = wordCount(); w < 2 * blocks; ++w) words[w] = 0;
+    }
+
+    bool operator==(const BitBuffer& other) const {
+        return length == other.length && (!blocks || std::memcmp(words, other.words, blocks * 16) == 0);
+    }
+private:
+    uint64_t length = 0, blocks = 0;
+    uint64_t* words = nullptr;
+    ShareArena* arena = nullptr; // where words came from, nullptr for the heap
+};
@@ -0,0 +1,82 @@
+#pragma once
+#include "common.tpp"
+#include "bit_buffer.tpp"
+#include <vector>
+#include <array>
+#include <stdexcept>
+
+// matching stage of the protocols: server's fingerprints are kept in a flat array of packed Bits-bit keys sorted by key,
+// and the client's fingerprints, which arrive tightly packed (see pack()), are sorted as well and matched by a single merge pass.
+// both sides are scanned sequentially, so the probe is cache friendly regardless of the number of points.
+// points of the server that share a fingerprint are all kept (and all reported on a match), rather than one silently
+// overwriting the other; collisionCount() tells how many fingerprints are ambiguous this way.
+template<uint64_t Bits>
+class FingerprintTable {
+public:
+    static constexpr uint64_t Words = (Bits + 63) / 64;
+    using Key = std::array<uint64_t, Words>; // bit i of the fingerprint is bit i % 64 of word i / 64
+
+    // wire format of the client's fingerprints: the count, then all fingerprints back to back, Bits bits each.
+    static std::vector<uint64_t> pack(const std::vector<std::bitset<Bits>>& fps) {
+        std::vector<uint64_t> ret(1 + (fps.size() * Bits + 63) / 64);
+        ret[0] = fps.size();
+        for (uint64_t i = 0; i < fps.size(); ++i) copyBits(bitsetWords(fps[i]), 0, ret.data() + 1, i * Bits, Bits);
+        return ret;
+    }
+
+    // packed comes from the client, so its count is checked against its length, before count * Bits could overflow.
+    // throws std::invalid_argument if they do not match.
+    static std::vector<Key> unpack(const std::vector<uint64_t>& packed) {
+        if (packed.empty() || packed[0] > (packed.size() - 1) * 64 / Bits || packed.size() != 1 + (packed[0] * Bits + 63) / 64)
+            throw std::invalid_argument("malformed fingerprints: " + std::to_string(packed.size()) + " words");
+        std::vector<Key> ret(packed[0]);
+        for (uint64_t i = 0; i < ret.size(); ++i) {
+            ret[i] = Key{};
+            copyBits(packed.data() + 1, i * Bits, ret[i].data(), 0, Bits);
+        }
+        return ret;
+    }
+
+    // fps[i] is the fingerprint of the server's i-th point.
+    FingerprintTable(const std::vector<std::bitset<Bits>>& fps): entries(fps.size()) {
+        for (uint64_t i = 0; i < fps.size(); ++i) {
+            entries[i].key = Key{};
+            std::copy(bitsetWords(fps[i]), bitsetWords(fps[i]) + Words, entries[i].key.begin());
+            entries[i].idx = i;
+        }
+        std::sort(entries.begin(), entries.end());
+    }
+
+    // indices of the server's points whose fingerprint is among the packed client fingerprints, sorted and without duplicates.
+    std::vector<uint64_t> match(const std::vector<uint64_t>& packed) const {
+        auto probes = unpack(packed);
+        std::sort(probes.begin(), probes.end());
+        probes.erase(std::unique(probes.begin(), probes.end()), probes.end());
+
+        std::vector<uint64_t> ret;
+        auto entry = entries.begin();
+        for (const auto& probe: probes) {
+            while (entry != entries.end() && entry->key < probe) ++entry;
+            for (; entry != entries.end() && entry->key == probe; ++entry) ret.push_back(entry->idx);
+        }
+        std::sort(ret.begin(), ret.end());
+        return ret;
+    }
+
+    // number of distinct fingerprints held by more than one point.
+    uint64_t collisionCount() const {
+        uint64_t ret = 0;
+        for (uint64_t i = 1; i < entries.size(); ++i)
+            if (entries[i].key == entries[i - 1].key && (i == 1 || entries[i - 1].key != entries[i - 2].key)) ++ret;
+        return ret;
+    }
+
+    uint64_t size() const { return entries.size(); }
+private:
+    struct Entry {
+        Key key;
+        uint64_t idx;
+        bool operator<(const Entry& other) const { return key != other.key ? key < other.key : idx < other.idx; }
+    };
+    std::vector<Entry> entries;
+};
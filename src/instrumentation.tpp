@@ -0,0 +1,94 @@
+#pragma once
+#include "common.tpp"
+#include <array>
+#include <chrono>
+#include <fstream>
+#include <sys/resource.h>
+
+// phases of a protocol run, as measured by Instrumentation.
+enum class Phase { StructureBuild, Encode, Ot, Payload, Evaluation, Matching };
+const uint64_t PhaseCount = 6;
+
+inline std::string phaseName(Phase phase) {
+    static const char* names[PhaseCount] = { "structure_build", "encode", "ot", "payload", "evaluation", "matching" };
+    return names[(uint64_t)phase];
+}
+
+// CPU time (user + system) of the whole process so far, all threads included.
+inline double processCpuSeconds() {
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+// peak resident set size of the process in bytes. read from VmHWM, which resetPeakRss() can lower back to the current
+// size, so consecutive measurements in one process do not all report the largest one. falls back to getrusage otherwise.
+inline uint64_t peakRssBytes() {
+    std::ifstream status("/proc/self/status");
+    for (std::string line; std::getline(status, line);)
+        if (line.rfind("VmHWM:", 0) == 0) return std::stoull(line.substr(6)) * 1024; // in kB
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (uint64_t)usage.ru_maxrss * 1024;
+}
+
+inline void resetPeakRss() {
+    std::ofstream("/proc/self/clear_refs") << "5"; // linux only, ignored elsewhere
+}
+
+// per-phase wall time, CPU time and bytes on the wire (both directions) of one party, summed over the runs since the last
+// reset(). CPU time is of the whole process, so when both parties run in one process it includes the other party's work
+// done at the same time. phases may overlap in time (e.g. the payload is streamed while encoding); time then goes to the
+// phase whose scope is open, bytes are always attributed to the phase they belong to.
+class Instrumentation {
+public:
+    struct PhaseStats {
+        double wallSeconds = 0, cpuSeconds = 0;
+        uint64_t bytes = 0;
+    };
+
+    // adds wall and CPU time between its construction and destruction to a phase.
+    class Scope {
+    public:
+        Scope(Instrumentation& target_, Phase phase_)
+            : target(target_), phase(phase_), wallStart(std::chrono::steady_clock::now()), cpuStart(processCpuSeconds()) {}
+        ~Scope() {
+            auto& stats = target.phases[(uint64_t)phase];
+            stats.wallSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+            stats.cpuSeconds += processCpuSeconds() - cpuStart;
+        }
+        Scope(const Scope&) = delete;
+    private:
+        Instrumentation& target;
+        Phase phase;
+        std::chrono::steady_clock::time_point wallStart;
+        double cpuStart;
+    };
+
+    Scope measure(Phase phase) { return Scope(*this, phase); }
+    void addBytes(Phase phase, uint64_t bytes) { phases[(uint64_t)phase].bytes += bytes; }
+    // share storage held at one time, the largest noted is kept.
+    void noteShareBytes(uint64_t bytes) { peakShareBytes = std::max(peakShareBytes, bytes); }
+    void reset() { phases = {}, peakShareBytes = 0; }
+    // adds up the phases of another run or party into this one.
+    void add(const Instrumentation& other) {
+        for (uint64_t phase = 0; phase < PhaseCount; ++phase) {
+            phases[phase].wallSeconds += other.phases[phase].wallSeconds;
+            phases[phase].cpuSeconds += other.phases[phase].cpuSeconds;
+            phases[phase].bytes += other.phases[phase].bytes;
+        }
+        noteShareBytes(other.peakShareBytes);
+    }
+
+    const PhaseStats& operator[](Phase phase) const { return phases[(uint64_t)phase]; }
+    uint64_t shareBytes() const { return peakShareBytes; }
+
+    uint64_t totalBytes() const {
+        uint64_t ret = 0;
+        for (auto& stats: phases) ret += stats.bytes;
+        return ret;
+    }
+private:
+    std::array<PhaseStats, PhaseCount> phases{};
+    uint64_t peakShareBytes = 0;
+};
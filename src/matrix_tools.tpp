@@ -1,4 +1,6 @@
 #pragma once
+#include <bit>
+#include <optional>
 #include "common.tpp"
 
 template <size_t N>
@@ -59,4 +61,59 @@ std::optional<std::bitset<M>> solveLinear(std::vector<std::bitset<M>> A, std::ve
         for(uint64_t j = 0; j < i; ++j) b[j] = b[j] ^ A[j][i]; // again
     }
     return x;
-}
\ No newline at end of file
+}
+
+// solves AX = B over GF(2) for all V columns of B at once, via a single Gauss-Jordan pass on the augmented matrix [A | B].
+// compared with calling solveLinear once per column, the matrix is copied and eliminated exactly once, and rows are
+// packed into contiguous 64-bit words so that a row operation is a plain word-wise XOR (which the compiler vectorises).
+// returns std::nullopt iff rows of A are linearly dependent, i.e. the elimination doubles as isFullRank.
+// otherwise returns X as M rows of V bits. free variables are set to 0, consistent with solveLinear.
+template<uint64_t M, uint64_t V>
+std::optional<std::vector<std::bitset<V>>> solveLinearBatch(const std::vector<std::bitset<M>>& A, const std::vector<std::bitset<V>>& B) {
+    assert(A.size() == B.size());
+    const uint64_t n = A.size();
+    if (n > M) return std::nullopt; // more equations than unknowns, can never be full rank.
+
+    // pack [A | B] row by row. bit b of A lives at column b, bit b of B lives at column M + b.
+    constexpr uint64_t W = (M + V + 63) / 64; // words per augmented row
+    std::vector<uint64_t> packed(n * W);
+    auto row = [&](uint64_t i) { return packed.data() + i * W; };
+    auto setBit = [](uint64_t* r, uint64_t col) { r[col / 64] |= 1ull << (col % 64); };
+    for (uint64_t i = 0; i < n; ++i) {
+        for (size_t b = A[i]._Find_first(); b < M; b = A[i]._Find_next(b)) setBit(row(i), b);
+        for (size_t b = B[i]._Find_first(); b < V; b = B[i]._Find_next(b)) setBit(row(i), M + b);
+    }
+
+    // forward + backward elimination in one go: each pivot is cleared from every other row.
+    // a row picked as pivot for column c has no bits left in columns < c, so XOR can start from word c / 64.
+    std::vector<uint64_t> pivotCol(n);
+    uint64_t rank = 0;
+    for (uint64_t c = 0; c < M && rank < n; ++c) {
+        const uint64_t word = c / 64, mask = 1ull << (c % 64);
+        uint64_t r = rank;
+        while (r < n && !(row(r)[word] & mask)) ++r;
+        if (r == n) continue; // free column
+        if (r != rank) std::swap_ranges(row(r), row(r) + W, row(rank));
+
+        const uint64_t* pivot = row(rank);
+        for (uint64_t j = 0; j < n; ++j) if (j != rank && (row(j)[word] & mask)) {
+            uint64_t* target = row(j);
+            for (uint64_t w = word; w < W; ++w) target[w] ^= pivot[w];
+        }
+        pivotCol[rank++] = c;
+    }
+    if (rank < n) return std::nullopt;
+
+    // row i now reads x[pivotCol[i]] = (B portion of row i); unpack it.
+    std::vector<std::bitset<V>> X(M);
+    for (uint64_t i = 0; i < n; ++i) {
+        const uint64_t* r = row(i);
+        for (uint64_t w = M / 64; w < W; ++w) {
+            for (uint64_t bits = r[w]; bits; bits &= bits - 1) {
+                uint64_t col = w * 64 + std::countr_zero(bits);
+                if (col >= M) X[pivotCol[i]][col - M] = 1;
+            }
+        }
+    }
+    return X;
+}
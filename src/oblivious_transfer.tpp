@@ -2,39 +2,50 @@
 #include <catch2/catch_test_macros.hpp>
 #include <coproto/Socket/AsioSocket.h>
 #include <libOTe/Base/BaseOT.h>
+#include <libOTe/config.h>
+
+// OT extensions, see OtBackend
+#include <libOTe/TwoChooseOne/Iknp/IknpOtExtSender.h>
+#include <libOTe/TwoChooseOne/Iknp/IknpOtExtReceiver.h>
+#ifdef ENABLE_SOFTSPOKEN_OT
+#include <libOTe/TwoChooseOne/SoftSpokenOT/SoftSpokenShOtExt.h>
+#endif
+#ifdef ENABLE_SILENTOT
+#include <libOTe/TwoChooseOne/Silent/SilentOtExtSender.h>
+#include <libOTe/TwoChooseOne/Silent/SilentOtExtReceiver.h>
+#endif
 
 // for hybrid encryption
 #include <cryptoTools/Common/Defines.h>
 #include <cryptoTools/Crypto/AES.h>
 
-// for transfer of custom encrypted data
-#include <cryptoTools/Network/Session.h>
-#include <cryptoTools/Network/IOService.h>
-#include <cryptoTools/Network/Channel.h>
-
 // debugging FIXME
 #include <dbg.h>
 
 #include "common.tpp"
+#include "bit_buffer.tpp"
+#include <memory>
+#include <mutex>
+#include <deque>
+#include <stdexcept>
 using namespace osuCrypto;
 
-// ports used for OT. port1 for transfer of key, port2 for transfer of ciphertext.
-static std::string port1 = ":2344";
-static std::string port2 = ":2345";
+// port of the connection carrying a whole transfer: OT of the keys, then the encrypted messages.
+static std::string transferPort = ":2344";
 
-// aux function for AES encryption and decryption.
-template<int N>
-std::array<block, N> aesEncrypt(std::array<block, N> data, const block key) {
+// hybrid encryption used by the OT below: every OT key encrypts exactly one message, so the key itself can seed an AES-CTR
+// keystream (counter from 0), which is XORed into data in place. encryption and decryption are the same operation.
+// compared to encrypting one ECB block at a time, the counter blocks are encrypted in batches that AES-NI pipelines, and
+// nothing is copied.
+inline void aesCtrXor(block* data, uint64_t blockCount, const block key) {
+    const uint64_t StepSize = 256; // keystream is produced in chunks that stay in L1
     details::AES<details::AESTypes::NI> aes(key);
-    for (auto& e: data) e = aes.ecbEncBlock(e);
-    return data;
-}
-
-template<int N>
-std::array<block, N> aesDecrypt(std::array<block, N> data, const block key) {
-    details::AESDec<details::AESTypes::NI> aes_dec(key);
-    for (auto& e: data) e = aes_dec.ecbDecBlock(e);
-    return data;
+    std::array<block, StepSize> keystream;
+    for (uint64_t offset = 0; offset < blockCount; offset += StepSize) {
+        uint64_t step = std::min(StepSize, blockCount - offset);
+        aes.ecbEncCounterMode(offset, step, keystream.data());
+        for (uint64_t i = 0; i < step; ++i) data[offset + i] = data[offset + i] ^ keystream[i];
+    }
 }
 
 // primitive conversion tools between libOTe's block type and STL bitset.
@@ -48,117 +59,410 @@ namespace conversion_tools {
         return ret;
     }
 
+    // block b holds bits [128b, 128b + 128) of x, low word first. the bitset's words are copied as they are (see bitsetWords).
     template<int N>
-    std::array<block, (N + 127) / 128> bsToBlocks(std::bitset<N> x) { 
-        static_assert(sizeof(unsigned long) == 8);
+    std::array<block, (N + 127) / 128> bsToBlocks(const std::bitset<N>& x) {
         std::array<block, (N + 127) / 128> ret;
-        for (uint64_t idx = 0; idx < (N + 127) / 128; ++idx) {
-            auto lsb = getTail<N>(x); x >>= 64;
-            auto msb = getTail<N>(x); x >>= 64;
-            ret[idx] = block(msb, lsb);
-        }
+        ret.back() = block(0, 0); // the last block may be only half covered by the bitset
+        std::memcpy(ret.data(), bitsetWords(x), (N + 63) / 64 * sizeof(uint64_t));
         return ret;
     }
 
-    // quite ugly function. note it only works for 128 bit block and 64 bit long.
+    // inverse of bsToBlocks. bits past N in the last block are ignored.
     template<int N>
     std::bitset<N> blocksToBs(const std::array<block, (N + 127) / 128>& x) {
-        static_assert(sizeof(unsigned long) == 8);
         std::bitset<N> ret;
-        
-        for (uint64_t idx = 0; idx < N; ++idx) {
-            uint64_t segment = ((block)x[idx / 128]).get<uint64_t>((idx % 128) / 64); // optimizable
-            ret[idx] = (segment & (1ull << (idx % 128 % 64))) != 0; 
-        }
+        uint64_t* words = bitsetWords(ret);
+        std::memcpy(words, x.data(), (N + 63) / 64 * sizeof(uint64_t));
+        if (N % 64) words[(N - 1) / 64] &= (1ull << (N % 64)) - 1;
         return ret;
     }
+
+    // uniform block representation of a share, so the OT code below works with both std::bitset and BitBuffer shares.
+    // shares are written into / read from caller provided blocks, so they can live directly inside a network buffer.
+    template<typename Share> struct ShareBlocks;
+
+    template<size_t N>
+    struct ShareBlocks<std::bitset<N>> {
+        static uint64_t bitLength(const std::bitset<N>&) { return N; }
+        static void writeBlocks(const std::bitset<N>& x, block* out) {
+            out[(N + 127) / 128 - 1] = block(0, 0);
+            std::memcpy(out, bitsetWords(x), (N + 63) / 64 * sizeof(uint64_t));
+        }
+        static std::bitset<N> fromBlocks(const block* x, uint64_t bitLength) {
+            if (bitLength != N) throw std::runtime_error("expected a share of " + std::to_string(N) + " bits, got " + std::to_string(bitLength));
+            std::bitset<N> ret;
+            copyBits(reinterpret_cast<const uint64_t*>(x), 0, bitsetWords(ret), 0, N);
+            return ret;
+        }
+    };
+
+    // BitBuffer storage is already block sized, see BitBuffer.
+    template<>
+    struct ShareBlocks<BitBuffer> {
+        static uint64_t bitLength(const BitBuffer& x) { return x.size(); }
+        static void writeBlocks(const BitBuffer& x, block* out) {
+            std::memcpy(out, x.data(), x.blockCount() * sizeof(block));
+        }
+        static BitBuffer fromBlocks(const block* x, uint64_t bitLength) {
+            BitBuffer ret(bitLength);
+            std::memcpy(ret.data(), x, ret.blockCount() * sizeof(block));
+            ret.clearPadding();
+            return ret;
+        }
+    };
 }
 
-// wrapper of libOTe (mostly modified from TwoChooseOne example) that also converts format to what we are using (bitsets)
-// this version also handles the hybrid encryption, so it supports OT of arbitrary length rather than 128 bits only.
-// Since signature of sender and receiver is different, I have to write two functions instead of one.
-template <typename OtExtSender, typename OtExtRecver, int BitLength, int NumItems>
-void TwoChooseOne_Sender(std::string receiver_ip, const std::array<std::pair<std::bitset<BitLength>, std::bitset<BitLength>>, NumItems>& content) {
-    const int PacketCount = (BitLength + 127) / 128; // since a block is 128 bit, we need ceil(BitLength / 128) copies of block to represent a bitset.
-    using Serialised = std::array<block, PacketCount>;
+// OT extensions the stream classes below can run on. which ones exist depends on how libOTe was built (libOTe/config.h),
+// IKNP is always required. SoftSpoken and Silent OT need far less communication than IKNP, silent OT at more computation.
+enum class OtBackend { Iknp, SoftSpoken, Silent };
 
-    auto chl = cp::asioConnect(receiver_ip + port1, true);
-    
-    OtExtSender sender = OtExtSender();
+inline std::string otBackendName(OtBackend backend) {
+    switch (backend) {
+    case OtBackend::Iknp: return "iknp";
+    case OtBackend::SoftSpoken: return "softspoken";
+    case OtBackend::Silent: return "silent";
+    }
+    return "unknown";
+}
 
-    DefaultBaseOT base;
-    BitVector bv(sender.baseOtCount());
-    std::vector<block> baseMsg(sender.baseOtCount());
-    PRNG prng(sysRandomSeed());
-    bv.randomize(prng);
+// backends compiled into this libOTe build.
+inline std::vector<OtBackend> availableOtBackends() {
+    std::vector<OtBackend> ret = { OtBackend::Iknp };
+#ifdef ENABLE_SOFTSPOKEN_OT
+    ret.push_back(OtBackend::SoftSpoken);
+#endif
+#ifdef ENABLE_SILENTOT
+    ret.push_back(OtBackend::Silent);
+#endif
+    return ret;
+}
 
-    cp::sync_wait(base.receive(bv, baseMsg, prng, chl));
-    sender.setBaseOts(baseMsg, bv);
-    
-    AlignedUnVector<std::array<block, 2>> sMsgs(NumItems);
-    prng.get(sMsgs.data(), sMsgs.size()); // populate random keys with random data
+// tag naming a pair of libOTe OT extension classes, e.g. OtExtension<IknpOtExtSender, IknpOtExtReceiver>{}.
+template<typename OtExtSender_, typename OtExtRecver_>
+struct OtExtension {
+    using Sender = OtExtSender_;
+    using Receiver = OtExtRecver_;
+};
 
-    cp::sync_wait(sender.send(sMsgs, prng, chl));
-    cp::sync_wait(chl.flush());
+// calls f(OtExtension<...>{}) with the classes implementing backend. throws if backend is not compiled in.
+template<typename F>
+void withOtExtension(OtBackend backend, F&& f) {
+    switch (backend) {
+    case OtBackend::Iknp: f(OtExtension<IknpOtExtSender, IknpOtExtReceiver>{}); return;
+#ifdef ENABLE_SOFTSPOKEN_OT
+    case OtBackend::SoftSpoken: f(OtExtension<SoftSpokenShOtSender<>, SoftSpokenShOtReceiver<>>{}); return;
+#endif
+#ifdef ENABLE_SILENTOT
+    case OtBackend::Silent: f(OtExtension<SilentOtExtSender, SilentOtExtReceiver>{}); return;
+#endif
+    default: throw std::invalid_argument("OT backend " + otBackendName(backend) + " is not enabled in this libOTe build");
+    }
+}
 
-    // note now transfer of Key is done. Next we need to transfer AES-encrypted data. 
-    std::vector<std::array<Serialised, PacketCount * 2>> EncryptedContents(NumItems);
-    for (uint64_t idx = 0; idx < NumItems; ++idx) {
-        EncryptedContents[idx][0] = aesEncrypt<PacketCount>(conversion_tools::bsToBlocks<BitLength>(content[idx].first), sMsgs[idx][0]);
-        EncryptedContents[idx][1] = aesEncrypt<PacketCount>(conversion_tools::bsToBlocks<BitLength>(content[idx].second), sMsgs[idx][1]);
+// silent OT sets up its own (silent) base OTs inside send / receive, the other extensions take them from DefaultBaseOT.
+template<typename OtExt>
+concept GeneratesOwnBaseOts = requires(OtExt& ext, PRNG& prng, cp::Socket& chl) { ext.genSilentBaseOts(prng, chl); };
+
+// OT extension of the sending end of one connection. base OTs are run with the first transfer and kept by the extension,
+// so further transfers over the same connection (e.g. later queries of a client session) only pay for the extension itself.
+class ReusableOtSender {
+public:
+    explicit ReusableOtSender(OtBackend backend = OtBackend::Iknp) {
+        withOtExtension(backend, [&](auto ext) { *this = ReusableOtSender(ext); });
     }
 
-    // transfer the struct with cryptoTools wrapper
-    IOService ios;
-    auto chl2 = Session(ios, receiver_ip + port2, SessionMode::Server).addChannel();
-    chl2.send(std::move(EncryptedContents));
+    template<typename OtExtSender_, typename OtExtRecver_>
+    explicit ReusableOtSender(OtExtension<OtExtSender_, OtExtRecver_>)
+        : sender(std::make_unique<OtExtSender_>()), ownBaseOts(GeneratesOwnBaseOts<OtExtSender_>) {}
 
-    std::cout << "Estimated communication for Keys (bytes): " << channelBuffSize(sMsgs) << std::endl;
-    std::cout << "Estimated communication for Contents (bytes): " << channelBuffSize(EncryptedContents) << std::endl;
+    // random OT of msgs.size() key pairs over chl. chl must lead to the same receiver every time.
+    void send(AlignedUnVector<std::array<block, 2>>& msgs, cp::Socket& chl) {
+        PRNG prng(sysRandomSeed());
+        if (!ownBaseOts && !sender->hasBaseOts()) {
+            DefaultBaseOT base;
+            BitVector bv(sender->baseOtCount());
+            std::vector<block> baseMsg(sender->baseOtCount());
+            bv.randomize(prng);
 
-}
+            cp::sync_wait(base.receive(bv, baseMsg, prng, chl));
+            sender->setBaseOts(baseMsg, bv);
+        }
+        cp::sync_wait(sender->send(msgs, prng, chl));
+        cp::sync_wait(chl.flush());
+    }
+private:
+    std::unique_ptr<OtExtSender> sender;
+    bool ownBaseOts = false;
+};
 
-// wrapper of libOTe (mostly modified from TwoChooseOne example) that also converts format to what we are using (bitsets)
-// this version also handles the hybrid encryption, so it supports OT of arbitrary length rather than 128 bits only.
-// Since signature of sender and receiver is different, I have to write two functions instead of one.
-template <typename OtExtSender, typename OtExtRecver, int BitLength, int NumItems>
-std::array<std::bitset<BitLength>, NumItems> TwoChooseOne_Receiver(std::string sender_ip, const std::bitset<NumItems>& choice_) {
-    const int PacketCount = (BitLength + 127) / 128;
-    using Serialised = std::array<block, PacketCount>;
+// receiving side of ReusableOtSender. backend must match the sender's.
+class ReusableOtReceiver {
+public:
+    explicit ReusableOtReceiver(OtBackend backend = OtBackend::Iknp) {
+        withOtExtension(backend, [&](auto ext) { *this = ReusableOtReceiver(ext); });
+    }
+
+    template<typename OtExtSender_, typename OtExtRecver_>
+    explicit ReusableOtReceiver(OtExtension<OtExtSender_, OtExtRecver_>)
+        : receiver(std::make_unique<OtExtRecver_>()), ownBaseOts(GeneratesOwnBaseOts<OtExtRecver_>) {}
+
+    // random OT of msgs.size() keys, msgs[i] being key choice[i] of the sender's i-th pair.
+    void receive(const BitVector& choice, AlignedUnVector<block>& msgs, cp::Socket& chl) {
+        PRNG prng(sysRandomSeed());
+        if (!ownBaseOts && !receiver->hasBaseOts()) {
+            DefaultBaseOT base;
+            std::vector<std::array<block, 2>> baseMsg(receiver->baseOtCount());
+            cp::sync_wait(base.send(baseMsg, prng, chl));
+            receiver->setBaseOts(baseMsg);
+        }
+        cp::sync_wait(receiver->receive(choice, msgs, prng, chl));
+        cp::sync_wait(chl.flush());
+    }
+private:
+    std::unique_ptr<OtExtReceiver> receiver;
+    bool ownBaseOts = false;
+};
+
+// random OTs run ahead of time (offline) over one connection, to be used up by later transfers over the same connection
+// (online, see TwoChooseOne_StreamSender). the sender holds random key pairs, the receiver one key of each pair, picked by
+// random choice bits c. both ends must fill and take the same counts in the same order.
+class RandomOtSenderPool {
+public:
+    explicit RandomOtSenderPool(OtBackend backend = OtBackend::Iknp): ot(backend) {}
+
+    // runs count more random OTs over chl.
+    void fill(uint64_t count, cp::Socket& chl) {
+        uint64_t before = chl.bytesSent() + chl.bytesReceived();
+        AlignedUnVector<std::array<block, 2>> fresh(count);
+        ot.send(fresh, chl);
+        keys.insert(keys.end(), fresh.begin(), fresh.end());
+        traffic += chl.bytesSent() + chl.bytesReceived() - before;
+    }
+
+    // removes the count oldest key pairs from the pool.
+    AlignedUnVector<std::array<block, 2>> take(uint64_t count) {
+        if (count > keys.size()) throw std::out_of_range("random OT pool holds " + std::to_string(keys.size()) + " OTs, " + std::to_string(count) + " needed");
+        AlignedUnVector<std::array<block, 2>> ret(count);
+        std::copy(keys.begin(), keys.begin() + count, ret.begin());
+        keys.erase(keys.begin(), keys.begin() + count);
+        return ret;
+    }
+
+    uint64_t size() const { return keys.size(); }
+    // bytes both ways spent filling the pool so far.
+    uint64_t fillBytes() const { return traffic; }
+private:
+    ReusableOtSender ot;
+    std::deque<std::array<block, 2>> keys;
+    uint64_t traffic = 0;
+};
 
-    auto chl = cp::asioConnect(sender_ip + port1, false);
+// receiving side of RandomOtSenderPool.
+class RandomOtReceiverPool {
+public:
+    explicit RandomOtReceiverPool(OtBackend backend = OtBackend::Iknp): ot(backend) {}
+
+    void fill(uint64_t count, cp::Socket& chl) {
+        uint64_t before = chl.bytesSent() + chl.bytesReceived();
+        PRNG prng(sysRandomSeed());
+        BitVector choice(count);
+        choice.randomize(prng);
+        AlignedUnVector<block> fresh(count);
+        ot.receive(choice, fresh, chl);
+        for (uint64_t i = 0; i < count; ++i) keys.push_back({ fresh[i], choice[i] });
+        traffic += chl.bytesSent() + chl.bytesReceived() - before;
+    }
 
-    OtExtRecver receiver = OtExtRecver();
+    // removes the count oldest keys from the pool, as (key, choice bit) pairs.
+    std::vector<std::pair<block, bool>> take(uint64_t count) {
+        if (count > keys.size()) throw std::out_of_range("random OT pool holds " + std::to_string(keys.size()) + " OTs, " + std::to_string(count) + " needed");
+        std::vector<std::pair<block, bool>> ret(keys.begin(), keys.begin() + count);
+        keys.erase(keys.begin(), keys.begin() + count);
+        return ret;
+    }
 
-    DefaultBaseOT base;
-    std::vector<std::array<block, 2>> baseMsg(receiver.baseOtCount());
-    PRNG prng(sysRandomSeed());
-    cp::sync_wait(base.send(baseMsg, prng, chl));
-    receiver.setBaseOts(baseMsg);
+    uint64_t size() const { return keys.size(); }
+    uint64_t fillBytes() const { return traffic; }
+private:
+    ReusableOtReceiver ot;
+    std::deque<std::pair<block, bool>> keys;
+    uint64_t traffic = 0;
+};
 
-    auto str = choice_.to_string();
-    std::reverse(str.begin(), str.end()); // due to endianness TODO verify
-    BitVector choice(str);
+// streaming wrapper of libOTe (mostly modified from TwoChooseOne example) with hybrid encryption.
+// the NumItems random key pairs are transferred by OT extension in the constructor, as they do not depend on the messages.
+// each message pair can then be encrypted and sent with send() as soon as it is ready, in any order and from any thread,
+// so the sender never holds all ciphertexts at once and the receiver can start working on the first pairs early.
+// everything goes over one connection; after the OT, a chunk is [ (idx, len0) | (0, len1) | Enc(k0, m0) | Enc(k1, m1) ], lengths in bits.
+class TwoChooseOne_StreamSender {
+public:
+    // listens on transferPort for the receiver, and runs the OT (base OTs included) over the new connection.
+    TwoChooseOne_StreamSender(std::string receiver_ip, uint64_t numItems, OtBackend backend = OtBackend::Iknp)
+        : ownOt(std::make_unique<ReusableOtSender>(backend)), chl(cp::asioConnect(receiver_ip + transferPort, true)), sMsgs(numItems) {
+        transferKeys(*ownOt);
+    }
 
-    AlignedUnVector<block> rMsgs(NumItems);
-    cp::sync_wait(receiver.receive(choice, rMsgs, prng, chl));
-    cp::sync_wait(chl.flush());
+    // runs the OT over an existing connection, whose base OTs ot keeps across transfers.
+    TwoChooseOne_StreamSender(cp::Socket chl_, uint64_t numItems, ReusableOtSender& ot): chl(chl_), sMsgs(numItems) {
+        transferKeys(ot);
+    }
 
-    // now having received key via OT, we decrypt the respective choices.
+    // uses numItems random OTs of pool instead of running the OT now. only the receiver's correction d = s ^ c of its random
+    // choices c to the wanted ones s is exchanged, after which m_b is sent under key b ^ d of the random pair.
+    TwoChooseOne_StreamSender(cp::Socket chl_, uint64_t numItems, RandomOtSenderPool& pool): chl(chl_), sMsgs(pool.take(numItems)) {
+        uint64_t before = chl.bytesSent() + chl.bytesReceived();
+        std::vector<uint64_t> correction;
+        cp::sync_wait(chl.recvResize(correction));
+        if (correction.size() != (numItems + 63) / 64)
+            throw std::runtime_error("OT choice correction of " + std::to_string(correction.size()) + " words, expected " + std::to_string((numItems + 63) / 64));
+        for (uint64_t idx = 0; idx < numItems; ++idx)
+            if ((correction[idx / 64] >> (idx % 64)) & 1) std::swap(sMsgs[idx][0], sMsgs[idx][1]);
+        keyTraffic = chl.bytesSent() + chl.bytesReceived() - before;
+    }
 
-    std::vector<std::array<Serialised, PacketCount * 2>> EncryptedContents(NumItems);
-    // receive the struct with cryptoTools wrapper
-    IOService ios;
-    auto chl2 = Session(ios, sender_ip + port2, SessionMode::Client).addChannel();
-    chl2.recv(EncryptedContents);
+    // encrypts m0, m1 under the idx-th key pair (see aesCtrXor) and sends them. thread safe, encryption happens outside of the lock.
+    template<typename Share>
+    void send(uint64_t idx, const Share& m0, const Share& m1) {
+        using Blocks = conversion_tools::ShareBlocks<Share>;
+        assert(idx < sMsgs.size());
+        uint64_t lengths[2] = { Blocks::bitLength(m0), Blocks::bitLength(m1) };
+        uint64_t blockCounts[2] = { (lengths[0] + 127) / 128, (lengths[1] + 127) / 128 };
 
-    std::array<std::bitset<BitLength>, NumItems> ret;
-    for (uint64_t idx = 0; idx < NumItems; ++idx) ret[idx] = conversion_tools::blocksToBs<BitLength>(
-        aesDecrypt<PacketCount>(
-            EncryptedContents[idx][choice_[idx]], 
-            rMsgs[idx]
-        )
-    );
+        // messages are serialised straight into the chunk and encrypted in place.
+        std::vector<block> chunk(2 + blockCounts[0] + blockCounts[1]);
+        chunk[0] = block(idx, lengths[0]);
+        chunk[1] = block(0, lengths[1]);
+        block* enc0 = chunk.data() + 2;
+        block* enc1 = enc0 + blockCounts[0];
+        Blocks::writeBlocks(m0, enc0);
+        Blocks::writeBlocks(m1, enc1);
+        aesCtrXor(enc0, blockCounts[0], sMsgs[idx][0]);
+        aesCtrXor(enc1, blockCounts[1], sMsgs[idx][1]);
+
+        std::lock_guard<std::mutex> guard(sendLock);
+        contentBytes += chunk.size() * sizeof(block);
+        cp::sync_wait(chl.send(std::move(chunk)));
+    }
+
+    // bytes both ways during the OT, base OTs included if they were run. with a pool, only the correction is counted.
+    uint64_t otBytes() const { return keyTraffic; }
+    uint64_t payloadBytes() const { return contentBytes; }
+private:
+    void transferKeys(ReusableOtSender& ot) {
+        uint64_t before = chl.bytesSent() + chl.bytesReceived();
+        ot.send(sMsgs, chl);
+        keyTraffic = chl.bytesSent() + chl.bytesReceived() - before;
+    }
+
+    std::unique_ptr<ReusableOtSender> ownOt; // only when the connection is ours
+    cp::Socket chl;
+    AlignedUnVector<std::array<block, 2>> sMsgs;
+    std::mutex sendLock;
+    uint64_t keyTraffic = 0, contentBytes = 0;
+};
+
+// receiving side of TwoChooseOne_StreamSender. backend must match the sender's.
+class TwoChooseOne_StreamReceiver {
+public:
+    // connects to the sender on transferPort, and runs the OT (base OTs included) over the new connection.
+    template<size_t NumItems>
+    TwoChooseOne_StreamReceiver(std::string sender_ip, const std::bitset<NumItems>& choice_, OtBackend backend = OtBackend::Iknp)
+        : ownOt(std::make_unique<ReusableOtReceiver>(backend)), chl(cp::asioConnect(sender_ip + transferPort, false)) {
+        transferKeys(choice_, *ownOt);
+    }
+
+    // runs the OT over an existing connection, whose base OTs ot keeps across transfers.
+    template<size_t NumItems>
+    TwoChooseOne_StreamReceiver(cp::Socket chl_, const std::bitset<NumItems>& choice_, ReusableOtReceiver& ot): chl(chl_) {
+        transferKeys(choice_, ot);
+    }
 
+    // uses NumItems random OTs of pool, see the matching constructor of TwoChooseOne_StreamSender.
+    template<size_t NumItems>
+    TwoChooseOne_StreamReceiver(cp::Socket chl_, const std::bitset<NumItems>& choice_, RandomOtReceiverPool& pool)
+        : chl(chl_), rMsgs(NumItems), choices(NumItems) {
+        uint64_t before = chl.bytesSent() + chl.bytesReceived();
+        std::vector<uint64_t> correction((NumItems + 63) / 64);
+        auto random = pool.take(NumItems);
+        for (uint64_t idx = 0; idx < NumItems; ++idx) {
+            rMsgs[idx] = random[idx].first; // key c of the pair, which the sender now uses for m_s
+            choices[idx] = choice_[idx];
+            if (choice_[idx] != random[idx].second) correction[idx / 64] |= 1ull << (idx % 64);
+        }
+        cp::sync_wait(chl.send(std::move(correction)));
+        keyTraffic = chl.bytesSent() + chl.bytesReceived() - before;
+    }
+
+    // blocks until the next chunk arrives, and returns its index together with the decrypted chosen message.
+    // chunks arrive in the order sender finished them, not necessarily by index.
+    template<typename Share>
+    std::pair<uint64_t, Share> receive() {
+        using Blocks = conversion_tools::ShareBlocks<Share>;
+        std::vector<block> chunk;
+        cp::sync_wait(chl.recvResize(chunk));
+        contentBytes += chunk.size() * sizeof(block);
+        // everything here comes from the peer, so the chunk is checked against its own header before it is touched.
+        if (chunk.size() < 2) throw std::runtime_error("OT chunk shorter than its header");
+        uint64_t idx = chunk[0].get<uint64_t>(1);
+        uint64_t lengths[2] = { chunk[0].get<uint64_t>(0), chunk[1].get<uint64_t>(0) };
+        uint64_t blockCounts[2] = { lengths[0] / 128 + (lengths[0] % 128 != 0), lengths[1] / 128 + (lengths[1] % 128 != 0) };
+        if (idx >= rMsgs.size()) throw std::runtime_error("OT chunk index " + std::to_string(idx) + " out of range");
+        if (blockCounts[0] > chunk.size() - 2 || blockCounts[1] != chunk.size() - 2 - blockCounts[0])
+            throw std::runtime_error("OT chunk length does not match its header");
+
+        bool c = choices[idx];
+        block* enc = chunk.data() + 2 + (c ? blockCounts[0] : 0);
+        aesCtrXor(enc, blockCounts[c], rMsgs[idx]);
+        return { idx, Blocks::fromBlocks(enc, lengths[c]) };
+    }
+
+    uint64_t otBytes() const { return keyTraffic; }
+    uint64_t payloadBytes() const { return contentBytes; }
+private:
+    template<size_t NumItems>
+    void transferKeys(const std::bitset<NumItems>& choice_, ReusableOtReceiver& ot) {
+        auto str = choice_.to_string();
+        std::reverse(str.begin(), str.end()); // due to endianness TODO verify
+        BitVector choice(str);
+        choices.resize(NumItems);
+        for (uint64_t idx = 0; idx < NumItems; ++idx) choices[idx] = choice_[idx];
+        rMsgs.resize(NumItems);
+
+        uint64_t before = chl.bytesSent() + chl.bytesReceived();
+        ot.receive(choice, rMsgs, chl);
+        keyTraffic = chl.bytesSent() + chl.bytesReceived() - before;
+    }
+
+    std::unique_ptr<ReusableOtReceiver> ownOt; // only when the connection is ours
+    cp::Socket chl;
+    AlignedUnVector<block> rMsgs;
+    std::vector<bool> choices;
+    uint64_t keyTraffic = 0, contentBytes = 0;
+};
+
+// one-shot wrapper of the stream classes above, which also converts format to what we are using (bitsets).
+// Since signature of sender and receiver is different, I have to write two functions instead of one.
+// messages are kept in vectors (NumItems of them), as NumItems large bitsets may not fit on the stack.
+template <typename OtExtSender, typename OtExtRecver, int BitLength, int NumItems>
+void TwoChooseOne_Sender(std::string receiver_ip, const std::vector<std::pair<std::bitset<BitLength>, std::bitset<BitLength>>>& content) {
+    assert(content.size() == NumItems);
+    ReusableOtSender ot(OtExtension<OtExtSender, OtExtRecver>{});
+    TwoChooseOne_StreamSender stream(cp::asioConnect(receiver_ip + transferPort, true), NumItems, ot);
+    for (uint64_t idx = 0; idx < NumItems; ++idx) stream.send(idx, content[idx].first, content[idx].second);
+
+    std::cerr << "Communication for OT of keys (bytes): " << stream.otBytes() << std::endl;
+    std::cerr << "Estimated communication for Contents (bytes): " << stream.payloadBytes() << std::endl;
+}
+
+template <typename OtExtSender, typename OtExtRecver, int BitLength, int NumItems>
+std::vector<std::bitset<BitLength>> TwoChooseOne_Receiver(std::string sender_ip, const std::bitset<NumItems>& choice_) {
+    ReusableOtReceiver ot(OtExtension<OtExtSender, OtExtRecver>{});
+    TwoChooseOne_StreamReceiver stream(cp::asioConnect(sender_ip + transferPort, false), choice_, ot);
+    std::vector<std::bitset<BitLength>> ret(NumItems);
+    for (uint64_t received = 0; received < NumItems; ++received) {
+        auto [idx, msg] = stream.receive<std::bitset<BitLength>>();
+        ret[idx] = std::move(msg);
+    }
     return ret;
-}
\ No newline at end of file
+}
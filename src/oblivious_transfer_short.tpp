@@ -64,7 +64,7 @@ void TwoChooseOne_Sender_Short(std::string receiver_ip, const std::array<std::pa
     cp::sync_wait(sender.sendChosen(sMsgs, prng, chl));
     cp::sync_wait(chl.flush());
 
-    std::cout << "Estimated total communication (bytes): " << channelBuffSize(sMsgs) << std::endl;
+    std::cerr << "Estimated total communication (bytes): " << channelBuffSize(sMsgs) << std::endl;
 
 }
 
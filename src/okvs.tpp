@@ -1,8 +1,11 @@
 #pragma once
 #include <climits>
+#include <stdexcept>
 #include <openssl/sha.h>
 #include "matrix_tools.tpp"
+#include "bit_buffer.tpp"
 #include "common.tpp"
+#include <cryptoTools/Crypto/AES.h>
 #include <dbg.h>
 
 namespace okvs {
@@ -37,10 +40,99 @@ namespace okvs {
         return ret;
     };
     
+    // public random permutation for streamHash below: AES under a fixed, publicly known key (first digits of pi),
+    // so every party and every thread derives the same rows.
+    inline const osuCrypto::details::AES<osuCrypto::details::AESTypes::NI>& fixedKeyAes() {
+        static const osuCrypto::details::AES<osuCrypto::details::AESTypes::NI> aes(osuCrypto::block(0x243f6a8885a308d3ull, 0x13198a2e03707344ull));
+        return aes;
+    }
+
+    // MMO compression with fixed key, h(x) = AES(x) ^ x, applied to count blocks in place. batched so AES-NI can pipeline.
+    inline void fixedKeyHash(osuCrypto::block* data, uint64_t count) {
+        const uint64_t StepSize = 64;
+        std::array<osuCrypto::block, StepSize> enc;
+        for (uint64_t offset = 0; offset < count; offset += StepSize) {
+            uint64_t step = std::min(StepSize, count - offset);
+            fixedKeyAes().ecbEncBlocks(data + offset, step, enc.data());
+            for (uint64_t i = 0; i < step; ++i) data[offset + i] = data[offset + i] ^ enc[i];
+        }
+    }
+
+    // 128 bits starting at bit 128 * idx of a bitset, zero padded.
+    template<size_t N>
+    osuCrypto::block bitsetBlock(const std::bitset<N>& x, uint64_t idx) {
+        const uint64_t* words = bitsetWords(x);
+        const uint64_t wordCount = (N + 63) / 64;
+        return osuCrypto::block(2 * idx + 1 < wordCount ? words[2 * idx + 1] : 0, 2 * idx < wordCount ? words[2 * idx] : 0);
+    }
+
+    // hash each of count binary strings of length I, under the same salt of length L, to length O: out[k] = streamHash(inputs[k], salt).
+    // salt || input is absorbed 128 bits at a time into a 128-bit state (h = MMO(h ^ m), state starts at the lengths, salt
+    // goes first so it is absorbed only once), then the state is expanded in counter mode: output block j is MMO(h ^ (j + 1)).
+    // work is done a group of keys at a time, so every AES call covers many independent blocks.
+    // security at most 2**64 (birthday bound of the 128-bit state), same as before.
+    template<uint64_t I, uint64_t L, uint64_t O>
+    void streamHashBatch(const std::bitset<I>* inputs, uint64_t count, const std::bitset<L>& salt, std::bitset<O>* out) {
+        using osuCrypto::block;
+        const uint64_t InputBlocks = (I + 127) / 128, OutputBlocks = (O + 127) / 128, OutputWords = (O + 63) / 64;
+        const uint64_t GroupSize = std::max<uint64_t>(1, 256 / std::max<uint64_t>(1, OutputBlocks));
+
+        block saltState(I, L);
+        for (uint64_t b = 0; b < (L + 127) / 128; ++b) {
+            saltState = saltState ^ bitsetBlock(salt, b);
+            fixedKeyHash(&saltState, 1);
+        }
+
+        std::vector<block> state(std::min(GroupSize, count)), expanded(state.size() * OutputBlocks);
+        for (uint64_t first = 0; first < count; first += GroupSize) {
+            const uint64_t group = std::min(GroupSize, count - first);
+            for (uint64_t k = 0; k < group; ++k) state[k] = saltState;
+            for (uint64_t b = 0; b < InputBlocks; ++b) {
+                for (uint64_t k = 0; k < group; ++k) state[k] = state[k] ^ bitsetBlock(inputs[first + k], b);
+                fixedKeyHash(state.data(), group);
+            }
+
+            for (uint64_t k = 0; k < group; ++k)
+                for (uint64_t j = 0; j < OutputBlocks; ++j) expanded[k * OutputBlocks + j] = state[k] ^ block(0, j + 1);
+            fixedKeyHash(expanded.data(), group * OutputBlocks);
+
+            for (uint64_t k = 0; k < group; ++k) {
+                uint64_t* words = bitsetWords(out[first + k]);
+                std::memcpy(words, expanded.data() + k * OutputBlocks, OutputWords * sizeof(uint64_t));
+                if (O % 64) words[OutputWords - 1] &= (1ull << (O % 64)) - 1;
+            }
+        }
+    }
+
+    // securely hash binary string of length I and salt L to arbitrary length O. shared by all PaXoS variants below.
+    // see streamHashBatch.
+    template<uint64_t I, uint64_t L, uint64_t O> 
+    std::bitset<O> streamHash(const std::bitset<I>& input, const std::bitset<L>& salt) {
+        std::bitset<O> ret;
+        streamHashBatch<I, L, O>(&input, 1, salt, &ret);
+        return ret;
+    }
+
+    // serialised layout shared by all PaXoS variants below, copied a word at a time (see copyBits).
+    // Layout: [ row 1 ][ row 2 ] .... [ row H ][ Nonce ]
+    //         0        V         .... V*(H-1)      V*H
+    template<uint64_t ValueLength, uint64_t Lambda, typename Rows>
+    void packEncoding(const Rows& rows, const std::bitset<Lambda>& nonce, uint64_t* out) {
+        for (uint64_t i = 0; i < rows.size(); ++i) copyBits(bitsetWords(rows[i]), 0, out, i * ValueLength, ValueLength);
+        copyBits(bitsetWords(nonce), 0, out, rows.size() * ValueLength, Lambda);
+    }
+
+    // inverse of packEncoding; rows must already have the right size.
+    template<uint64_t ValueLength, uint64_t Lambda, typename Rows>
+    void unpackEncoding(const uint64_t* in, Rows& rows, std::bitset<Lambda>& nonce) {
+        for (uint64_t i = 0; i < rows.size(); ++i) copyBits(in, i * ValueLength, bitsetWords(rows[i]), 0, ValueLength);
+        copyBits(in, rows.size() * ValueLength, bitsetWords(nonce), 0, Lambda);
+    }
+
     // PaXoS using Random Boolean Matrix method (as described in "PSI from PaXoS: Fast, Malicious Private Set Intersection")
     // basically encoding is just randomly generate v until the matrix is full rank, then solve a AX=B under GF_{ValueLength} field.
-    // mt19937 is used in 2 places: 1) act as RNG source in lambda string 2) act as 'hasher'
-    // also stick to SHA256 for hashing.
+    // mt19937 only draws the Lambda bit nonce. keys are hashed, salted by the nonce, to their matrix rows with the fixed-key
+    // AES MMO construction of streamHashBatch, all keys of one attempt in a batch.
     template<uint64_t KeyLength, uint64_t ValueLength, uint64_t Lambda, uint64_t MaxEncodingAttempt = 10>
     struct RandomBooleanPaXoS {
     protected:
@@ -49,6 +141,9 @@ namespace okvs {
         static constexpr uint64_t HashedKeyLength = KeyLength + Lambda;
     public:
         using EncodedPaXoS = std::array<std::bitset<ValueLength>, HashedKeyLength>;
+        static constexpr bool FixedSize = true; // serialised length does not depend on number of keys
+        static constexpr uint64_t SerialisedLength = ValueLength * HashedKeyLength + Lambda; // see serialize()
+        using Serialised = std::bitset<SerialisedLength>;
         using Key = std::bitset<KeyLength>;
         using Nonce = std::bitset<Lambda>;
         using Value = std::bitset<ValueLength>;
@@ -61,24 +156,17 @@ namespace okvs {
             randomEngine = std::mt19937_64((*randomSource)());
         }
 
-        // securely hash binary string of length I and salt L to arbitrary length O
-        // security at most 2**64, TODO improve security up to mt19937_64's space
-        template<uint64_t I, uint64_t L, uint64_t O> 
-        std::bitset<O> streamHash(const std::bitset<I>& input, const std::bitset<L>& salt) {
-            // hash salted input via SHA256.
-            std::bitset<I + L> combinedInput(input.to_string() + salt.to_string()); // note this essentially "Reverse" them, due to bitset print MSB first. not very efficient
-
-            // std::bitset<256> hashed = SHA256Hash<I + L>(combinedInput); TODO FIXME
-
-            // compress the 256-bit hash into 64 bit, which is used to seed mt19937_64
-            uint64_t prngSeed = 0;
-            for (uint64_t i = 0; i < I + L; ++i) if (combinedInput[i]) prngSeed ^= (1ll << (i % 64));
+        // seeds the nonce generator directly, e.g. with a per-thread stream when encoding in parallel.
+        RandomBooleanPaXoS(uint64_t seed): randomEngine(seed) {}
 
-            // finally, generate output vector.
-            auto v = std::mt19937_64(prngSeed);
-            auto ret = GetBitSequenceFromPRNG<O>(v);
+        // see okvs::streamHash.
+        template<uint64_t I, uint64_t L, uint64_t O> 
+        static std::bitset<O> streamHash(const std::bitset<I>& input, const std::bitset<L>& salt) {
+            return okvs::streamHash<I, L, O>(input, salt);
+        }
 
-            return ret;
+        constexpr static uint64_t serialisedLengthFor(uint64_t) {
+            return SerialisedLength;
         }
 
         // encodes the PaXoS, from key-value pairs.
@@ -87,31 +175,23 @@ namespace okvs {
             // there is no need for padding if the hamming weight of v is sufficiently large (which is the case since v is random, hamming weight is half of bitlength).
             size_t n = kvs.size(); // number of key-value pairs we wish to encode.
             using HashedKey = std::bitset<HashedKeyLength>;
+            std::vector<Key> keys(n);
+            std::vector<Value> values(n); // right-hand side of the system, i.e. the value portion of kvs
+            for (uint64_t j = 0; j < n; ++j) keys[j] = kvs[j].first, values[j] = kvs[j].second;
             for (uint64_t trial = 0; trial <= MaxEncodingAttempt; ++trial) {
-                // firstly, we generate the whole encoded matrix.
+                // firstly, we generate the whole encoded matrix: for each key[i], evaluate v(key[i]). note v in paper is implemented as streamHash here
                 auto nonce = GetBitSequenceFromPRNG<Lambda>(randomEngine);
-                std::vector<HashedKey> currMatrix;
-                for (auto& [key, value]: kvs) { // for each key[i], evaluate v(key[i]). note v in paper is implemented as streamHash here
-                    auto encodedKey = streamHash<KeyLength, Lambda, HashedKeyLength>(key, nonce);
-                    currMatrix.emplace_back(encodedKey);
-                }
-                assert(currMatrix.size() == kvs.size());
+                std::vector<HashedKey> currMatrix(n);
+                streamHashBatch<KeyLength, Lambda, HashedKeyLength>(keys.data(), n, nonce, currMatrix.data());
 
-                // next, we check if the generated matrix is linearly independent. 
-                if (isFullRank<HashedKeyLength>(currMatrix)) {
+                // next, we solve AX = B for all ValueLength columns at once. a single Gauss-Jordan pass over the packed
+                // augmented matrix also tells us whether the generated matrix is linearly independent; if not, retry with another nonce.
+                auto solution = solveLinearBatch<HashedKeyLength, ValueLength>(currMatrix, values);
+                if (solution.has_value()) {
                     // std::cout << "Found suitable nonce at " << trial + 1 << "th try. Nonce: " << nonce << std::endl;
                     EncodedPaXoS encoded;
-                    // we enter the encoding phase.
-                    // for each of the columns, perform a Ax = b.
-                    for (uint64_t i = 0; i < ValueLength; ++i) {
-                        std::vector<bool> q(n);
-                        for (uint64_t j = 0; j < n; ++j) q[j] = kvs[j].second[i]; // taking vertical slice of value portion of kvs matrix
-                        auto ret_wrapper = solveLinear<HashedKeyLength>(currMatrix, q);
-                        assert(ret_wrapper.has_value());
-                        auto ret = ret_wrapper.value();
-                        for (uint64_t j = 0; j < HashedKeyLength; ++j) encoded[j][i] = ret[j]; // copy to encode
-                    }
-                    return std::make_pair(encoded, nonce) ;
+                    std::copy(solution->begin(), solution->end(), encoded.begin());
+                    return std::make_pair(encoded, nonce);
                 }
             }
             return std::nullopt;
@@ -119,43 +199,243 @@ namespace okvs {
 
         // decode a PaXoS from some key.
         // decoding always succeed, and is equivalent to MUXing paxos by selected bits.
-        Value decode(const EncodedPaXoS& encoded, const Nonce& nonce, const Key& key) {
-            Value ret; 
-            auto vx = streamHash<KeyLength, Lambda, HashedKeyLength>(key, nonce);
-            for (uint64_t i = 0; i < HashedKeyLength; ++i) if (vx[i]) ret = ret ^ encoded[i];
-            return ret;
+        Value decode(const EncodedPaXoS& encoded, const Nonce& nonce, const Key& key) const {
+            return combineRows(encoded, streamHash<KeyLength, Lambda, HashedKeyLength>(key, nonce));
+        }
+
+        // decodes many keys at once: hashes them in one batch (see streamHashBatch), then combines rows for each.
+        void decodeBatch(const EncodedPaXoS& encoded, const Nonce& nonce, const std::vector<Key>& keys, std::vector<Value>& out) const {
+            std::vector<std::bitset<HashedKeyLength>> hashed(keys.size());
+            streamHashBatch<KeyLength, Lambda, HashedKeyLength>(keys.data(), keys.size(), nonce, hashed.data());
+            out.resize(keys.size());
+            for (uint64_t k = 0; k < keys.size(); ++k) out[k] = combineRows(encoded, hashed[k]);
         }
         
-        // helper function that serialises PaXoS given into single bitset.
-        // copies bit by bit, not very efficient. use with caution.
-        // Layout: [ row 1 ][ row 2 ] .... [ row H ][ Nonce ]
-        //         0        V         .... V*(H-1)      V*H
-        Opt<std::bitset<ValueLength * HashedKeyLength + Lambda>> serialize(const Opt<std::pair<EncodedPaXoS, Nonce>>& encoded) {
-            if (encoded.has_value()) {
-                auto [paxos, nc] = encoded.value();
-                std::bitset<ValueLength * HashedKeyLength + Lambda> ret;
-                // copies paxos
-                for (uint64_t i = 0; i < HashedKeyLength; ++i) {
-                    for (uint64_t currBit = 0; currBit < ValueLength; ++currBit) ret[i * ValueLength + currBit] = paxos[i][currBit];
-                }
-                // copies tail
-                for (uint64_t i = 0; i < Lambda; ++i) ret[ValueLength * HashedKeyLength + i] = nc[i];
-                return ret;
-            } else return std::nullopt;
+        // helper function that serialises PaXoS given into single bitset. see packEncoding for layout.
+        Opt<std::bitset<ValueLength * HashedKeyLength + Lambda>> serialize(const Opt<std::pair<EncodedPaXoS, Nonce>>& encoded) const {
+            std::bitset<ValueLength * HashedKeyLength + Lambda> ret;
+            if (serialize(encoded, ret)) return ret;
+            else return std::nullopt;
+        }
+
+        // same, into existing storage. returns false if encoding failed.
+        bool serialize(const Opt<std::pair<EncodedPaXoS, Nonce>>& encoded, Serialised& out) const {
+            if (!encoded.has_value()) return false;
+            const auto& [paxos, nc] = encoded.value();
+            packEncoding<ValueLength, Lambda>(paxos, nc, bitsetWords(out));
+            return true;
         }
 
         // extracts EncodedPaXoS and Nonce from serialised bitstream. see serialize() for note.
-        std::pair<EncodedPaXoS, Nonce> deserialize(const std::bitset<ValueLength * HashedKeyLength + Lambda>& bits) {
+        std::pair<EncodedPaXoS, Nonce> deserialize(const std::bitset<ValueLength * HashedKeyLength + Lambda>& bits) const {
             EncodedPaXoS paxos;
             Nonce nc;
+            unpackEncoding<ValueLength, Lambda>(bitsetWords(bits), paxos, nc);
+            return std::make_pair(paxos, nc);
+        }
+    private:
+        // XOR of the rows selected by hashed key. rows are whole bitsets, so this XORs whole words.
+        static Value combineRows(const EncodedPaXoS& encoded, const std::bitset<HashedKeyLength>& vx) {
+            Value ret;
+            for (size_t i = vx._Find_first(); i < HashedKeyLength; i = vx._Find_next(i)) ret ^= encoded[i];
+            return ret;
+        }
+    };
+    // PaXoS using Random Band Matrix method (as described in "Near-Optimal Oblivious Key-Value Stores for Efficient PSI, PSU and Volume-Hiding Multi-Maps")
+    // each key is hashed to a start position and a BandWidth-bit random band, i.e. row = band << start. unlike the dense version above,
+    // the encoding has Rows rows regardless of key length, and Rows only needs to be slightly larger than the number of keys.
+    // after sorting rows by start, Gaussian elimination only ever touches one machine word per row, so encoding is O(n * BandWidth)
+    // and decoding is XOR of (on average BandWidth / 2) rows.
+    // Rows == 0 selects the sized mode: the encoding gets n * (1 + EpsilonPercent / 100) + BandWidth rows for n keys, decided at
+    // encoding time, and is serialised to a BitBuffer whose length therefore scales with the number of keys.
+    template<uint64_t KeyLength, uint64_t ValueLength, uint64_t Lambda, uint64_t Rows, uint64_t EpsilonPercent = 10, uint64_t MaxEncodingAttempt = 10>
+    struct RandomBandPaXoS {
+    protected:
+        std::mt19937_64 randomEngine;
+        std::unique_ptr<std::random_device> randomSource;
+    public:
+        static constexpr uint64_t BandWidth = 64; // one machine word
+        static_assert(Rows == 0 || Rows >= BandWidth);
+        static_assert(ValueLength > 0);
+        static constexpr bool FixedSize = Rows != 0;
+        static constexpr uint64_t SerialisedLength = FixedSize ? ValueLength * Rows + Lambda : 0; // see serialize(). 0 if sized
+        using Serialised = std::conditional_t<FixedSize, std::bitset<SerialisedLength>, BitBuffer>;
+        using EncodedPaXoS = std::vector<std::bitset<ValueLength>>; // rowsFor(n) rows. on heap since it can be large.
+        using Key = std::bitset<KeyLength>;
+        using Nonce = std::bitset<Lambda>;
+        using Value = std::bitset<ValueLength>;
+        template<typename T> using Opt = std::optional<T>;
+
+        RandomBandPaXoS(std::unique_ptr<std::random_device> RandomSource)
+        {
+            randomSource = std::move(RandomSource);
+            randomEngine = std::mt19937_64((*randomSource)());
+        }
+
+        // see RandomBooleanPaXoS(uint64_t).
+        RandomBandPaXoS(uint64_t seed): randomEngine(seed) {}
+
+        // number of rows used to encode n keys.
+        constexpr static uint64_t rowsFor(uint64_t n) {
+            if constexpr (FixedSize) return Rows;
+            else return n + (n * EpsilonPercent + 99) / 100 + BandWidth;
+        }
+
+        // length of serialised encoding of n keys.
+        constexpr static uint64_t serialisedLengthFor(uint64_t n) {
+            return ValueLength * rowsFor(n) + Lambda;
+        }
+
+        // maps key to (start, band) in an encoding of given number of rows.
+        // lowest bit of band is always set so that start is the first column the key touches.
+        static std::pair<uint64_t, uint64_t> bandOf(const Key& key, const Nonce& nonce, uint64_t rows) {
+            return bandOf(streamHash<KeyLength, Lambda, 128>(key, nonce), rows);
+        }
+
+        // same, from the already hashed key.
+        static std::pair<uint64_t, uint64_t> bandOf(const std::bitset<128>& hashed, uint64_t rows) {
+            const uint64_t* words = bitsetWords(hashed);
+            return std::make_pair(words[0] % (rows - BandWidth + 1), words[1] | 1);
+        }
+
+        // encodes the PaXoS, from key-value pairs.
+        // returns (1) the encoded vector (2) the nonce, or std::nullopt if the encoding process failed.
+        Opt<std::pair<EncodedPaXoS, Nonce>> encode(const std::vector<std::pair<Key, Value>>& kvs) {
+            struct Row { uint64_t start, band; Value value; };
+            const uint64_t n = kvs.size(), rowCount = rowsFor(n);
+            if (n > rowCount) return std::nullopt;
+
+            std::vector<Key> keys(n);
+            for (uint64_t i = 0; i < n; ++i) keys[i] = kvs[i].first;
+            std::vector<std::bitset<128>> hashed(n);
+
+            for (uint64_t trial = 0; trial <= MaxEncodingAttempt; ++trial) {
+                auto nonce = GetBitSequenceFromPRNG<Lambda>(randomEngine);
+                streamHashBatch<KeyLength, Lambda, 128>(keys.data(), n, nonce, hashed.data());
+                std::vector<Row> rows(n);
+                for (uint64_t i = 0; i < n; ++i) {
+                    auto [start, band] = bandOf(hashed[i], rowCount);
+                    rows[i] = Row{start, band, kvs[i].second};
+                }
+                std::sort(rows.begin(), rows.end(), [](const Row& a, const Row& b) { return a.start < b.start; });
 
-            // restores paxos
-            for (uint64_t i = 0; i < HashedKeyLength; ++i) {
-                for (uint64_t currBit = 0; currBit < ValueLength; ++currBit) paxos[i][currBit] = bits[i * ValueLength + currBit];
+                // forward elimination. pivotOf[c] is the index of row whose leading column is c.
+                // since rows are processed by increasing start, a row reduced by earlier pivots never extends past start + BandWidth,
+                // so we can keep each row as a single word relative to its own start.
+                std::vector<int64_t> pivotOf(rowCount, -1);
+                bool failed = false;
+                for (uint64_t i = 0; i < n && !failed; ++i) {
+                    auto& row = rows[i];
+                    while (row.band) {
+                        uint64_t lead = row.start + std::countr_zero(row.band);
+                        if (pivotOf[lead] == -1) { pivotOf[lead] = i; break; }
+                        const auto& pivot = rows[pivotOf[lead]];
+                        row.band ^= pivot.band >> (row.start - pivot.start);
+                        row.value ^= pivot.value;
+                    }
+                    // row got cancelled out: fine if value is also cancelled, otherwise the system is inconsistent.
+                    if (!row.band && row.value.any()) failed = true;
+                }
+                if (failed) continue;
+
+                // back substitution, from the last column down. free columns are filled with randomness.
+                EncodedPaXoS encoded(rowCount);
+                for (uint64_t c = rowCount; c--;) {
+                    if (pivotOf[c] == -1) {
+                        encoded[c] = GetBitSequenceFromPRNG<ValueLength>(randomEngine);
+                        continue;
+                    }
+                    const auto& row = rows[pivotOf[c]];
+                    Value x = row.value;
+                    uint64_t rest = row.band & (row.band - 1); // drop the leading bit, which is c itself
+                    for (; rest; rest &= rest - 1) x ^= encoded[row.start + std::countr_zero(rest)];
+                    encoded[c] = x;
+                }
+                return std::make_pair(std::move(encoded), nonce);
             }
-            // restores tail
-            for (uint64_t i = 0; i < Lambda; ++i) nc[i] = bits[ValueLength * HashedKeyLength + i];
-            return std::make_pair(paxos, nc);
+            return std::nullopt;
+        }
+
+        // decode a PaXoS from some key.
+        // decoding always succeed, and is equivalent to XORing rows selected by the band.
+        Value decode(const EncodedPaXoS& encoded, const Nonce& nonce, const Key& key) const {
+            return combineRows(encoded, bandOf(key, nonce, encoded.size()));
+        }
+
+        // decodes many keys at once: hashes them in one batch (see streamHashBatch), then combines rows for each.
+        void decodeBatch(const EncodedPaXoS& encoded, const Nonce& nonce, const std::vector<Key>& keys, std::vector<Value>& out) const {
+            std::vector<std::bitset<128>> hashed(keys.size());
+            streamHashBatch<KeyLength, Lambda, 128>(keys.data(), keys.size(), nonce, hashed.data());
+            out.resize(keys.size());
+            for (uint64_t k = 0; k < keys.size(); ++k) out[k] = combineRows(encoded, bandOf(hashed[k], encoded.size()));
+        }
+
+        // same layout as RandomBooleanPaXoS::serialize (see packEncoding), with rowsFor(n) rows.
+        Opt<Serialised> serialize(const Opt<std::pair<EncodedPaXoS, Nonce>>& encoded) const {
+            Serialised ret;
+            if (serialize(encoded, ret)) return ret;
+            else return std::nullopt;
+        }
+
+        // same, into existing storage. a BitBuffer of the right length (e.g. from a ShareArena) is written in place, any other
+        // is replaced by one from the heap. returns false if encoding failed.
+        bool serialize(const Opt<std::pair<EncodedPaXoS, Nonce>>& encoded, Serialised& out) const {
+            if (!encoded.has_value()) return false;
+            const auto& [paxos, nc] = encoded.value();
+            if constexpr (FixedSize) packEncoding<ValueLength, Lambda>(paxos, nc, bitsetWords(out));
+            else {
+                if (out.size() != ValueLength * paxos.size() + Lambda) out = BitBuffer(ValueLength * paxos.size() + Lambda);
+                packEncoding<ValueLength, Lambda>(paxos, nc, out.data());
+            }
+            return true;
+        }
+
+        // extracts EncodedPaXoS and Nonce from serialised bitstream. see serialize() for note.
+        // a sized encoding comes from the wire, so it must hold the nonce and a whole number of rows, at least BandWidth of them
+        // (see bandOf); throws std::invalid_argument otherwise.
+        std::pair<EncodedPaXoS, Nonce> deserialize(const Serialised& bits) const {
+            if (bits.size() < Lambda + ValueLength * BandWidth || (bits.size() - Lambda) % ValueLength)
+                throw std::invalid_argument("malformed band OKVS encoding of " + std::to_string(bits.size()) + " bits");
+            EncodedPaXoS paxos((bits.size() - Lambda) / ValueLength);
+            Nonce nc;
+            if constexpr (FixedSize) unpackEncoding<ValueLength, Lambda>(bitsetWords(bits), paxos, nc);
+            else unpackEncoding<ValueLength, Lambda>(bits.data(), paxos, nc);
+            return std::make_pair(std::move(paxos), nc);
         }
+    private:
+        // XOR of the rows selected by (start, band). rows are whole bitsets, so this XORs whole words.
+        static Value combineRows(const EncodedPaXoS& encoded, std::pair<uint64_t, uint64_t> startAndBand) {
+            auto [start, band] = startAndBand;
+            Value ret;
+            for (; band; band &= band - 1) ret ^= encoded[start + std::countr_zero(band)];
+            return ret;
+        }
+    };
+
+    // OKVS backends, used as policy by SpatialHash and the protocols to pick which PaXoS they instantiate.
+    // a backend exposes Okvs<KeyLength, ValueLength, Lambda>, which must provide encode / decode / serialize / deserialize,
+    // Serialised, FixedSize, SerialisedLength and serialisedLengthFor(n) as RandomBooleanPaXoS does.
+
+    // dense random boolean matrix. holds at most KeyLength + Lambda keys; encoding is cubic in that.
+    struct DenseBackend {
+        template<uint64_t KeyLength, uint64_t ValueLength, uint64_t Lambda>
+        using Okvs = RandomBooleanPaXoS<KeyLength, ValueLength, Lambda>;
+    };
+
+    // random band matrix, holding at most Capacity keys in Capacity * (1 + EpsilonPercent / 100) + BandWidth rows.
+    // encoding is near-linear in Capacity, and does not depend on key length.
+    template<uint64_t Capacity, uint64_t EpsilonPercent = 10>
+    struct BandBackend {
+        static constexpr uint64_t Rows = Capacity + (Capacity * EpsilonPercent + 99) / 100 + 64;
+        template<uint64_t KeyLength, uint64_t ValueLength, uint64_t Lambda>
+        using Okvs = RandomBandPaXoS<KeyLength, ValueLength, Lambda, Rows>;
+    };
+
+    // random band matrix sized to the data: n keys take n * (1 + EpsilonPercent / 100) + BandWidth rows, so there is no capacity
+    // to pick in advance, and the serialised share (a BitBuffer) grows with the number of keys actually inserted.
+    template<uint64_t EpsilonPercent = 10>
+    struct SizedBandBackend {
+        template<uint64_t KeyLength, uint64_t ValueLength, uint64_t Lambda>
+        using Okvs = RandomBandPaXoS<KeyLength, ValueLength, Lambda, 0, EpsilonPercent>;
     };
 }
\ No newline at end of file
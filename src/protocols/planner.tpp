@@ -0,0 +1,288 @@
+#pragma once
+#include "common.tpp"
+#include "spatialhash_tt.tpp"
+#include "spatialhash_concat_tt.tpp"
+#include "xorshare_tt.tpp"
+#include <utility>
+
+// the recipes RecipePlanner picks from.
+enum class Recipe { SpatialhashTt, SpatialhashConcatTt, XorshareTt };
+const uint64_t RecipeCount = 3;
+
+inline std::string recipeName(Recipe recipe) {
+    static const char* names[RecipeCount] = { "spatialhash_tt", "spatialhash_concat_tt", "xorshare_tt" };
+    return names[(uint64_t)recipe];
+}
+
+// coefficients of RecipePlanner's time estimate, in seconds of one core. defaults are fitted to grs22_bench runs with the
+// sized band OKVS; compare the predicted and actual costs RecipePlanner prints to refit them for another machine.
+struct CostModel {
+    // server, per share and occupied cell: OKVS encoding of the cell, plus filling its truth table(s) per bit of cell value.
+    double okvsCellSeconds = 370e-9, ttBitSeconds = 26e-9, concatBitSeconds = 180e-9;
+    // server, per share and coordinate of either axis (xorshare_tt), 2 * 2 ^ bitLength of them.
+    double axisEntrySeconds = 30e-9;
+    // both parties, per point and repetition: a spatial hash lookup, plus per bit of cell value decoded; or 2 table lookups.
+    double hashEvalSeconds = 55e-9, concatEvalSeconds = 95e-9, evalBitSeconds = 0.2e-9, xorEvalSeconds = 10e-9;
+    // bytes per second of the link, to weigh bytes against time. 100 Mbit/s on default.
+    double bandwidth = 12.5e6;
+};
+
+// picks the recipe and cellBitLength of a run from the actual input, and runs it. the server looks at its balls (which
+// cells they occupy, whether every cell holds a product of X and Y as spatialhash_concat_tt needs, whether they are
+// globally axis disjoint as xorshare_tt needs) and at the client's point count, which the client sends first. for each
+// feasible candidate it estimates the bytes on the wire exactly from the share length (SpatialHash::getOutputSize) and the
+// fingerprint width, and the time through CostModel, then picks the lowest time + bytes / bandwidth. the choice is sent
+// to the client, and both parties run the matching precompiled instantiation over the same connection.
+// candidates are the three recipes with cellBitLength 1 to MaxCellBitLength (below bitLength), all with the same Lambda:
+// Lambda bounds the OKVS failure probability, so it is not traded against cost.
+// on the wire, before the run: the client's { point count }, then the server's { recipe, cellBitLength }.
+template<int bitLength, int Lambda, int L, int MaxCellBitLength = 5, typename OkvsBackend = okvs::SizedBandBackend<>>
+class RecipePlanner {
+public:
+    using Point = std::pair<uint64_t, uint64_t>;
+
+    struct Candidate {
+        Recipe recipe;
+        int cellBitLength; // 0 for xorshare_tt, which has no cells
+        bool feasible = false;
+        uint64_t cells = 0, shareBits = 0; // occupied cells, bits of each share
+        double seconds = 0; // predicted, both parties
+        uint64_t bytes = 0; // predicted, shares and fingerprints (OT is the same for every candidate)
+
+        double cost(const CostModel& model) const {
+            return seconds + bytes / model.bandwidth;
+        }
+    };
+
+    // every candidate for Alice's balls and a client holding clientPointCount points, with its estimate if feasible.
+    std::vector<Candidate> plan(const std::vector<Point>& centers, uint32_t radius, uint64_t clientPointCount) const {
+        return plan(BallIndex(centers, radius).expand(1ull << bitLength), clientPointCount);
+    }
+
+    std::vector<Candidate> plan(const std::vector<Point>& alicePoints, uint64_t clientPointCount) const {
+        const double encodeThreads = std::min<uint64_t>(threadCount, L), evalThreads = threadCount;
+        const uint64_t evaluated = alicePoints.size() + clientPointCount;
+        std::vector<Candidate> ret;
+        forEachCandidate([&]<Recipe recipe, int cellBitLength>() {
+            using Protocol = Instance<recipe, cellBitLength>;
+            Candidate candidate{ recipe, cellBitLength };
+            double shareSeconds, pointSeconds;
+            if constexpr (recipe == Recipe::XorshareTt) {
+                candidate.feasible = axisDisjoint(alicePoints);
+                candidate.shareBits = Protocol::Bfss::ShareLength;
+                shareSeconds = model.axisEntrySeconds * 2 * (1ull << bitLength);
+                pointSeconds = model.xorEvalSeconds;
+            } else {
+                using SuitableSpatialHash = typename Protocol::SuitableSpatialHash;
+                const uint64_t valueBits = typename SuitableSpatialHash::Value().size();
+                auto [cells, products] = occupiedCells(alicePoints, cellBitLength);
+                candidate.feasible = recipe == Recipe::SpatialhashTt || products;
+                candidate.cells = cells;
+                candidate.shareBits = SuitableSpatialHash::getOutputSize(cells);
+                double bitSeconds = recipe == Recipe::SpatialhashTt ? model.ttBitSeconds : model.concatBitSeconds;
+                shareSeconds = cells * (model.okvsCellSeconds + bitSeconds * valueBits);
+                pointSeconds = (recipe == Recipe::SpatialhashTt ? model.hashEvalSeconds : model.concatEvalSeconds) + model.evalBitSeconds * valueBits;
+            }
+            // each repetition sends [ header | Enc(share0) | Enc(share1) ] in 128 bit blocks, see TwoChooseOne_StreamSender.
+            const uint64_t payload = L * 16 * (2 + 2 * ((candidate.shareBits + 127) / 128));
+            // the client's fingerprints, packed after their count (see FingerprintTable::pack). concat gives 2 bits per repetition.
+            const uint64_t fingerprintBits = recipe == Recipe::SpatialhashConcatTt ? 2 * L : L;
+            candidate.bytes = payload + 8 * (1 + (clientPointCount * fingerprintBits + 63) / 64);
+            candidate.seconds = 2 * L * shareSeconds / encodeThreads + L * evaluated * pointSeconds / evalThreads;
+            ret.push_back(candidate);
+        });
+        return ret;
+    }
+
+    // the feasible candidate of lowest time + bytes / bandwidth. spatialhash_tt fits any set, so there is always one.
+    Candidate best(const std::vector<Candidate>& candidates) const {
+        const Candidate* ret = nullptr;
+        for (auto& candidate: candidates)
+            if (candidate.feasible && (!ret || candidate.cost(model) < ret->cost(model))) ret = &candidate;
+        if (!ret) throw std::invalid_argument("no recipe fits Alice's structure");
+        return *ret;
+    }
+
+    // Set intersection server, see GRS22_L_infinity_protocol::SetIntersectionServer. the recipe is picked once the client's
+    // point count is known.
+    std::set<Point> SetIntersectionServer(const std::vector<Point>& centers, const string& clientIP, uint32_t radius) {
+        cp::Socket chl = cp::asioConnect(clientIP + transferPort, true);
+        ReusableOtSender ot(otBackend);
+        return RunServer(centers, radius, chl, ot);
+    }
+
+    // Set intersection client, see GRS22_L_infinity_protocol::SetIntersectionClient. runs the recipe the server picked.
+    void SetIntersectionClient(const std::vector<Point>& points, const string& serverIP) {
+        cp::Socket chl = cp::asioConnect(serverIP + transferPort, false);
+        ReusableOtReceiver ot(otBackend);
+        RunClient(points, chl, ot);
+    }
+
+    // one run over an established connection, see GRS22_L_infinity_protocol::RunServer.
+    std::set<Point> RunServer(const std::vector<Point>& centers, uint32_t radius, cp::Socket& chl, ReusableOtSender& ot) {
+        metrics.reset();
+        std::vector<uint64_t> request;
+        cp::sync_wait(chl.recvResize(request));
+        std::vector<Point> alicePoints;
+        std::vector<Candidate> candidates;
+        {
+            auto scope = metrics.measure(Phase::StructureBuild); // planning included
+            alicePoints = BallIndex(centers, radius).expand(1ull << bitLength);
+            candidates = plan(alicePoints, request.at(0));
+        }
+        choice = best(candidates);
+        for (auto& candidate: candidates) {
+            if (!candidate.feasible) continue;
+            std::cerr << "Candidate " << recipeName(candidate.recipe) << " cellBitLength " << candidate.cellBitLength << ": " << candidate.cells
+                      << " cells, " << candidate.shareBits << " bit shares, predicted " << candidate.seconds << " s and " << candidate.bytes << " bytes." << std::endl;
+        }
+        cp::sync_wait(chl.send(std::vector<uint64_t>{ (uint64_t)choice.recipe, (uint64_t)choice.cellBitLength }));
+
+        std::set<Point> ret;
+        dispatch(choice, [&]<typename Protocol>() {
+            Protocol psi;
+            configure(psi);
+            auto structure = [&] {
+                auto scope = metrics.measure(Phase::StructureBuild);
+                return Protocol::fromPoints(std::move(alicePoints));
+            }();
+            ret = psi.RunServer(structure, chl, ot);
+            metrics.add(psi.instrumentation());
+        });
+
+        // Ot is the same for every candidate and StructureBuild is done before the choice, so neither is predicted.
+        double seconds = 0;
+        for (Phase phase: { Phase::Encode, Phase::Payload, Phase::Evaluation, Phase::Matching }) seconds += metrics[phase].wallSeconds;
+        std::cerr << "Picked " << recipeName(choice.recipe) << " cellBitLength " << choice.cellBitLength << ": predicted " << choice.seconds
+                  << " s and " << choice.bytes << " bytes, took " << seconds << " s and " << metrics[Phase::Payload].bytes + metrics[Phase::Matching].bytes
+                  << " bytes (plus " << metrics[Phase::Ot].bytes << " bytes of OT)." << std::endl;
+        return ret;
+    }
+
+    // one run over an established connection, see GRS22_L_infinity_protocol::RunClient.
+    void RunClient(const std::vector<Point>& points, cp::Socket& chl, ReusableOtReceiver& ot) {
+        metrics.reset();
+        cp::sync_wait(chl.send(std::vector<uint64_t>{ points.size() }));
+        std::vector<uint64_t> picked;
+        cp::sync_wait(chl.recvResize(picked));
+        choice = Candidate{ (Recipe)picked.at(0), (int)picked.at(1) };
+        dispatch(choice, [&]<typename Protocol>() {
+            Protocol psi;
+            configure(psi);
+            psi.RunClient(points, chl, ot);
+            metrics.add(psi.instrumentation());
+        });
+    }
+
+    // the candidate of the last run. estimates are only known to the server.
+    const Candidate& lastChoice() const {
+        return choice;
+    }
+
+    // per-phase time and bytes of the last run, of the recipe run plus planning (as StructureBuild).
+    const Instrumentation& instrumentation() const {
+        return metrics;
+    }
+
+    // passed on to the recipe run, see GRS22_L_infinity_protocol. the thread count is also used in the estimates.
+    void setThreadCount(uint64_t threadCount_) {
+        threadCount = std::max<uint64_t>(1, threadCount_);
+    }
+    void setOtBackend(OtBackend otBackend_) {
+        otBackend = otBackend_;
+    }
+    void setShareMemoryLimit(uint64_t bytes) {
+        shareMemoryLimit = bytes;
+    }
+    void setCostModel(const CostModel& model_) {
+        model = model_;
+    }
+private:
+    // xorshare_tt has no cells; its instantiation takes one cell spanning the whole domain, so grouping points is trivial.
+    template<Recipe recipe, int cellBitLength>
+    using Instance = std::conditional_t<recipe == Recipe::SpatialhashTt, spatialhash_tt<bitLength, Lambda, L, cellBitLength, OkvsBackend>,
+                     std::conditional_t<recipe == Recipe::SpatialhashConcatTt, spatialhash_concat_tt<bitLength, Lambda, L, cellBitLength, OkvsBackend>,
+                                        xorshare_tt<bitLength, Lambda, L, bitLength>>>;
+
+    // calls f.template operator()<recipe, cellBitLength>() for every candidate.
+    template<typename F>
+    static void forEachCandidate(F&& f) {
+        f.template operator()<Recipe::XorshareTt, 0>();
+        forEachCellBitLength(f, std::make_integer_sequence<int, MaxCellBitLength>{});
+    }
+
+    template<typename F, int... Indices>
+    static void forEachCellBitLength(F& f, std::integer_sequence<int, Indices...>) {
+        (forCellBitLength<Indices + 1>(f), ...);
+    }
+
+    template<int cellBitLength, typename F>
+    static void forCellBitLength(F& f) {
+        if constexpr (cellBitLength < bitLength) {
+            f.template operator()<Recipe::SpatialhashTt, cellBitLength>();
+            f.template operator()<Recipe::SpatialhashConcatTt, cellBitLength>();
+        }
+    }
+
+    // calls f.template operator()<Protocol>() with the instantiation of candidate.
+    template<typename F>
+    static void dispatch(const Candidate& candidate, F&& f) {
+        bool found = false;
+        forEachCandidate([&]<Recipe recipe, int cellBitLength>() {
+            if (recipe != candidate.recipe || cellBitLength != candidate.cellBitLength) return;
+            found = true;
+            f.template operator()<Instance<recipe, cellBitLength>>();
+        });
+        if (!found) throw std::invalid_argument("no instantiation of " + recipeName(candidate.recipe) + " with cellBitLength " + std::to_string(candidate.cellBitLength));
+    }
+
+    template<typename Protocol>
+    void configure(Protocol& psi) const {
+        psi.setThreadCount(threadCount);
+        psi.setOtBackend(otBackend);
+        psi.setShareMemoryLimit(shareMemoryLimit);
+    }
+
+    // number of cells of side 2 ^ cellBitLength holding points, and whether the points of every cell are a product X x Y.
+    static std::pair<uint64_t, bool> occupiedCells(const std::vector<Point>& points, int cellBitLength) {
+        std::vector<std::array<uint64_t, 3>> keyed; // cell, x, y
+        keyed.reserve(points.size());
+        for (auto [x, y]: points) keyed.push_back({ (x >> cellBitLength) << 32 | (y >> cellBitLength), x, y });
+        std::sort(keyed.begin(), keyed.end());
+
+        uint64_t cells = 0;
+        bool products = true;
+        std::vector<uint64_t> ys;
+        for (uint64_t begin = 0, end; begin < keyed.size(); begin = end) {
+            uint64_t xs = 0;
+            ys.clear();
+            for (end = begin; end < keyed.size() && keyed[end][0] == keyed[begin][0]; ++end) {
+                if (end == begin || keyed[end][1] != keyed[end - 1][1]) ++xs;
+                ys.push_back(keyed[end][2]);
+            }
+            std::sort(ys.begin(), ys.end());
+            const uint64_t distinctYs = std::unique(ys.begin(), ys.end()) - ys.begin();
+            products &= (end - begin) == xs * distinctYs; // points are distinct, so this holds iff the cell is X x Y
+            ++cells;
+        }
+        return { cells, products };
+    }
+
+    static bool axisDisjoint(const std::vector<Point>& points) {
+        typename Instance<Recipe::XorshareTt, 0>::Structure structure;
+        structure.points = points;
+        try {
+            Instance<Recipe::XorshareTt, 0>::products(structure);
+            return true;
+        } catch (const std::invalid_argument&) {
+            return false;
+        }
+    }
+
+    uint64_t threadCount = defaultThreadCount();
+    OtBackend otBackend = OtBackend::Iknp;
+    uint64_t shareMemoryLimit = std::numeric_limits<uint64_t>::max();
+    CostModel model;
+    Candidate choice{ Recipe::SpatialhashTt, 0 };
+    Instrumentation metrics;
+};
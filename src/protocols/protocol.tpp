@@ -3,13 +3,16 @@
 #include "bfss/spatial_hash.tpp"
 #include "bfss/trivial_bfss.tpp"
 #include "oblivious_transfer.tpp"
-#include <libOTe/TwoChooseOne/Iknp/IknpOtExtReceiver.h>
-#include <libOTe/TwoChooseOne/Iknp/IknpOtExtSender.h>
+#include "thread_pool.tpp"
+#include "ball_index.tpp"
+#include "instrumentation.tpp"
+#include "bit_buffer.tpp"
+#include "fingerprint_table.tpp"
 
-// for transfer of fingerprints
-#include <cryptoTools/Network/Session.h>
-#include <cryptoTools/Network/IOService.h>
-#include <cryptoTools/Network/Channel.h>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
 
 #include <dbg.h>
 
@@ -26,20 +29,73 @@ template<int bitLength, int Lambda, int L, int cellBitLength>
 class GRS22_L_infinity_protocol {
 public:
     using Point = std::pair<uint64_t, uint64_t>;
+    static constexpr uint64_t Repetitions = L; // number of OTs per run
+
+    // Alice's structure expanded into points and grouped by cell. depends only on centers and radius, so a server answering
+    // many queries on the same structure builds it once (see PsiServer). points are enumerated from the balls directly
+    // (see BallIndex), so cost scales with the area of Alice's balls rather than with the whole 2^bitLength x 2^bitLength domain.
+    struct Structure {
+        std::vector<Point> points;
+        std::map<Point, std::vector<Point>> pointsByCell;
+    };
+
+    static Structure expand(const std::vector<Point>& centers, uint32_t radius) {
+        return fromPoints(BallIndex(centers, radius).expand(1ull << bitLength));
+    }
+
+    // same, from the points of Alice's balls already enumerated (see BallIndex::expand).
+    static Structure fromPoints(std::vector<Point> points) {
+        static_assert(cellBitLength <= 32); // so that we can (conveniently) perform arithmetic in uint64_t.
+        const uint64_t cellLength = 1ull << cellBitLength;
+        Structure ret;
+        ret.points = std::move(points);
+        for (auto [x, y]: ret.points) ret.pointsByCell[std::make_pair(x / cellLength, y / cellLength)].emplace_back(x, y);
+        return ret;
+    }
+
     // Set intersection server, holding structure and yielding intersection result. 
-    // use Iknp as OT protocol on default.
+    // OT extension is Iknp on default, see setOtBackend.
     // @param centers       the vector of points storing center of Alice's balls.
     // @param clientIP      IP of client. Port is not needed and is setted above.
     // @param radius        radius of Alice's spheres.
-    virtual std::set<Point> SetIntersectionServer(const std::vector<Point>& centers, const string& clientIP, uint32_t radius) = 0;
+    std::set<Point> SetIntersectionServer(const std::vector<Point>& centers, const string& clientIP, uint32_t radius) {
+        metrics.reset();
+        const Structure structure = [&] {
+            auto scope = metrics.measure(Phase::StructureBuild);
+            return expand(centers, radius);
+        }();
+        std::cerr << "Alice's structure contains in total " << structure.points.size() << " points." << std::endl;
+        cp::Socket chl = cp::asioConnect(clientIP + transferPort, true);
+        ReusableOtSender ot(otBackend);
+        return RunServer(structure, chl, ot);
+    }
 
     // Set intersection client, holding unstructued points and yield nothing. 
-    // use Iknp as OT protocol on default.
+    // OT extension is Iknp on default, see setOtBackend.
     // @param points        the vector of Bob's points.
     // @param serverIP      IP of server. Port is not needed and is setted above.
-    virtual void SetIntersectionClient(const std::vector<Point>& points, const string& serverIP) = 0;
+    void SetIntersectionClient(const std::vector<Point>& points, const string& serverIP) {
+        metrics.reset();
+        cp::Socket chl = cp::asioConnect(serverIP + transferPort, false);
+        ReusableOtReceiver ot(otBackend);
+        RunClient(points, chl, ot);
+    }
+
+    // one run of the protocol over an established connection. all phases (OT, shares, fingerprints) go over chl, and ot
+    // keeps the base OTs of chl, so a connection can carry many runs. the client must call RunClient with a matching ot.
+    virtual std::set<Point> RunServer(const Structure& structure, cp::Socket& chl, ReusableOtSender& ot) = 0;
+    virtual void RunClient(const std::vector<Point>& points, cp::Socket& chl, ReusableOtReceiver& ot) = 0;
     
-    // L-infinity membership test. TODO optimize
+    // the points of points inside any ball, computed in the clear through BallIndex::contains: the expected outcome of a run,
+    // for checking and benchmarking the protocols on inputs too large for membership below.
+    static std::set<Point> plainIntersection(const std::vector<Point>& centers, uint64_t radius, const std::vector<Point>& points) {
+        const BallIndex balls(centers, radius);
+        std::set<Point> ret;
+        for (auto [x, y]: points) if (balls.contains(x, y)) ret.emplace(x, y);
+        return ret;
+    }
+
+    // L-infinity membership test, by linear scan over all centers. kept simple on purpose, as a reference for BallIndex.
     bool membership(const std::vector<Point>& centers, uint64_t x, uint64_t y, uint64_t radius) { 
         for (auto [currX, currY]: centers) {
             if (std::max(
@@ -48,4 +104,251 @@ public:
         }
         return false;
     };
+
+    // number of threads used to encode the L repetitions. defaults to all cores.
+    void setThreadCount(uint64_t threadCount_) {
+        threadCount = std::max<uint64_t>(1, threadCount_);
+    }
+    // OT extension used to transfer the shares. both parties must pick the same one. see OtBackend.
+    void setOtBackend(OtBackend otBackend_) {
+        otBackend = otBackend_;
+    }
+
+    // per-phase time and bytes of this party. SetIntersectionServer / SetIntersectionClient start from zero, while runs
+    // through RunServer / RunClient (and prepare) add up until resetInstrumentation().
+    const Instrumentation& instrumentation() const {
+        return metrics;
+    }
+    void resetInstrumentation() {
+        metrics.reset();
+    }
+
+    // upper bound on the memory Alice's shares may take during one run (or one prepare), none by default. a run that
+    // would need more throws std::length_error before encoding anything. see shareArena.
+    void setShareMemoryLimit(uint64_t bytes) {
+        shareMemoryLimit = bytes;
+    }
+protected:
+    void checkShareMemory(uint64_t bytes) const {
+        if (bytes > shareMemoryLimit)
+            throw std::length_error("shares need " + std::to_string(bytes) + " bytes, over the limit of " + std::to_string(shareMemoryLimit));
+    }
+
+    uint64_t threadCount = defaultThreadCount();
+    OtBackend otBackend = OtBackend::Iknp;
+    uint64_t shareMemoryLimit = std::numeric_limits<uint64_t>::max();
+    Instrumentation metrics;
+};
+
+// the steps of GRS22's protocol common to all recipes: OT of the L share pairs, evaluation of Alice's and Bob's points on
+// them, and matching of the fingerprints, either in one go or split into an offline (prepare) and an online phase.
+// a recipe derives from this (CRTP) and provides, as members this class can reach (e.g. by befriending it):
+// - Share, the type of a half-share, a std::bitset or a runtime sized BitBuffer;
+// - shareBits(structure), the length of each share for structure, throwing std::invalid_argument if the recipe does not fit it;
+// - encodeShares(structure, arena, onDone), step 1, calling onDone(trial, pair) from a worker thread with the share pair of
+//   each repetition as soon as it is encoded (runtime sized shares are stored in arena if given). the pair is dropped once
+//   onDone returns, unless moved out, so a streamed run holds only the repetitions being encoded;
+// - aliceChoice(), the half-share of every repetition Alice evaluates her own points on;
+// - evaluateShare(share, points, threads), the FingerprintBits / L fingerprint bits of every point at one repetition, packed
+//   into one byte per point (lowest bit first).
+template<typename Recipe, typename Share, uint64_t FingerprintBits, int bitLength, int Lambda, int L, int cellBitLength>
+class GRS22_recipe_protocol: public GRS22_L_infinity_protocol<bitLength, Lambda, L, cellBitLength> {
+public:
+    using Point = std::pair<uint64_t, uint64_t>;
+    using typename GRS22_L_infinity_protocol<bitLength, Lambda, L, cellBitLength>::Structure;
+    using SharePair = std::pair<Share, Share>;
+    using SharePairs = std::vector<SharePair>; // on the heap: fixed size shares easily outgrow a stack
+    using Fingerprint = std::bitset<FingerprintBits>;
+    static constexpr uint64_t BitsPerRepetition = FingerprintBits / L;
+
+    // everything of one run on Alice's side that does not depend on Bob, so it can be made offline ahead of the query: the L
+    // share pairs of her structure and her own fingerprint table. a Prepared is consumed by the run it is used in: sending its
+    // shares to a second client would let the two of them together learn both shares of a repetition.
+    struct Prepared {
+        std::unique_ptr<ShareArena> arena; // storage of runtime sized shares, see shareArena
+        SharePairs shares;
+        FingerprintTable<FingerprintBits> table;
+    };
+
+    Prepared prepare(const Structure& structure) {
+        auto arena = shareArena(structure, 2 * L); // all of them are kept
+        SharePairs shares(L);
+        {
+            auto scope = this->metrics.measure(Phase::Encode);
+            recipe().encodeShares(structure, arena.get(), [&](uint64_t trial, SharePair& pair) { shares[trial] = std::move(pair); });
+        }
+        noteShareMemory(arena.get(), 2 * L);
+        auto scope = this->metrics.measure(Phase::Evaluation);
+        FingerprintTable<FingerprintBits> table = aliceTable(structure, shares);
+        return Prepared{ std::move(arena), std::move(shares), std::move(table) };
+    }
+
+    // Set intersection server, answering one query of the client on chl. see GRS22_L_infinity_protocol::RunServer.
+    std::set<Point> RunServer(const Structure& structure, cp::Socket& chl, ReusableOtSender& ot) {
+        return runServer(structure, chl, ot);
+    }
+
+    // same, but the OT keys come from pool (see RandomOtSenderPool), so only Bob's choice correction is exchanged for them.
+    std::set<Point> RunServer(const Structure& structure, cp::Socket& chl, RandomOtSenderPool& pool) {
+        return runServer(structure, chl, pool);
+    }
+
+    // online phase only: shares and fingerprint table come from prepare(structure), the OT keys from pool. prepared is moved in,
+    // and one that was used already (moved from) is refused before anything is sent.
+    std::set<Point> RunServer(const Structure& structure, Prepared prepared, cp::Socket& chl, RandomOtSenderPool& pool) {
+        if (prepared.shares.size() != L) throw std::invalid_argument("prepared run was used already");
+        TwoChooseOne_StreamSender transfer = [&] {
+            auto scope = this->metrics.measure(Phase::Ot);
+            return TwoChooseOne_StreamSender(chl, L, pool);
+        }();
+        {
+            auto scope = this->metrics.measure(Phase::Payload);
+            for (uint64_t trial = 0; trial < L; ++trial) transfer.send(trial, prepared.shares[trial].first, prepared.shares[trial].second);
+        }
+        return matchFingerprints(structure, prepared.table, transfer, chl);
+    }
+
+    // Set intersection client, sending one query to the server on chl. see GRS22_L_infinity_protocol::RunClient.
+    void RunClient(const std::vector<Point>& points, cp::Socket& chl, ReusableOtReceiver& ot) {
+        runClient(points, chl, ot);
+    }
+
+    // same, but the OT keys come from pool, see RandomOtReceiverPool.
+    void RunClient(const std::vector<Point>& points, cp::Socket& chl, RandomOtReceiverPool& pool) {
+        runClient(points, chl, pool);
+    }
+protected:
+    Recipe& recipe() {
+        return static_cast<Recipe&>(*this);
+    }
+
+    template<typename OtSource>
+    std::set<Point> runServer(const Structure& structure, cp::Socket& chl, OtSource& ot) {
+        // a structure the recipe does not fit, or shares over the memory limit, are refused before anything is sent.
+        const uint64_t heldShares = 2 * std::min<uint64_t>(this->threadCount, L);
+        auto arena = shareArena(structure, heldShares);
+
+        // steps 1 to 3 are interleaved: OT of the L key pairs does not depend on the shares so it runs first, then each
+        // repetition is encrypted and sent to Bob as soon as both of its shares are encoded (see TwoChooseOne_StreamSender),
+        // evaluated on Alice's own points and dropped. so only the repetitions being encoded are held at a time.
+        TwoChooseOne_StreamSender transfer = [&] {
+            auto scope = this->metrics.measure(Phase::Ot);
+            return TwoChooseOne_StreamSender(chl, L, ot);
+        }();
+        const std::bitset<L> s = recipe().aliceChoice();
+        std::vector<Fingerprint> alicePrints(structure.points.size());
+        std::mutex printsLock;
+        {
+            auto scope = this->metrics.measure(Phase::Encode); // the payload is sent, and Alice's points evaluated, meanwhile
+            recipe().encodeShares(structure, arena.get(), [&](uint64_t trial, SharePair& pair) {
+                transfer.send(trial, pair.first, pair.second);
+                auto bits = recipe().evaluateShare(s[trial] ? pair.second : pair.first, structure.points, 1); // already on a worker
+                std::lock_guard<std::mutex> guard(printsLock);
+                setFingerprintBits(trial, bits, alicePrints);
+            });
+        }
+        noteShareMemory(arena.get(), heldShares);
+
+        if constexpr (std::is_same_v<Share, BitBuffer>)
+            std::cerr << "Share length (bits): " << recipe().shareBits(structure) << " for " << structure.pointsByCell.size() << " cells." << std::endl;
+        auto table = [&] {
+            auto scope = this->metrics.measure(Phase::Evaluation);
+            return aliceTable(alicePrints);
+        }();
+        return matchFingerprints(structure, table, transfer, chl);
+    }
+
+    // storage for count runtime sized shares held at a time. fixed size shares need none (nullptr), they are std::bitset held
+    // in their share pairs. either way the memory count shares take is checked against shareMemoryLimit.
+    std::unique_ptr<ShareArena> shareArena(const Structure& structure, uint64_t count) {
+        const uint64_t shareBits = recipe().shareBits(structure);
+        std::unique_ptr<ShareArena> ret;
+        uint64_t bytes = count * sizeof(Share);
+        if constexpr (std::is_same_v<Share, BitBuffer>) {
+            bytes = count * ShareArena::slotBytesFor(shareBits);
+            if (bytes <= this->shareMemoryLimit) ret = std::make_unique<ShareArena>(shareBits, count);
+        }
+        this->checkShareMemory(bytes);
+        return ret;
+    }
+
+    // notes the memory held by shares in a run, once done: the peak of arena, or count fixed size shares.
+    void noteShareMemory(ShareArena* arena, uint64_t count) {
+        this->metrics.noteShareBytes(arena ? arena->peakBytes() : count * sizeof(Share));
+    }
+
+    // step 3. We also generate fingerprint for every element of ours with the half-shares picked by aliceChoice.
+    FingerprintTable<FingerprintBits> aliceTable(const Structure& structure, const SharePairs& shares) {
+        const std::bitset<L> s = recipe().aliceChoice();
+        std::vector<Fingerprint> alicePrints(structure.points.size());
+        for (uint64_t i = 0; i < L; ++i)
+            setFingerprintBits(i, recipe().evaluateShare(s[i] ? shares[i].second : shares[i].first, structure.points, this->threadCount), alicePrints);
+        return aliceTable(alicePrints);
+    }
+
+    // our fingerprints go into a sorted table; points sharing a fingerprint are all kept.
+    FingerprintTable<FingerprintBits> aliceTable(const std::vector<Fingerprint>& alicePrints) {
+        FingerprintTable<FingerprintBits> table(alicePrints);
+        if (table.collisionCount()) std::cerr << "Alice has " << table.collisionCount() << " fingerprints shared by several points." << std::endl;
+        return table;
+    }
+
+    std::set<Point> matchFingerprints(const Structure& structure, const FingerprintTable<FingerprintBits>& table, const TwoChooseOne_StreamSender& transfer, cp::Socket& chl) {
+        this->metrics.addBytes(Phase::Ot, transfer.otBytes());
+        this->metrics.addBytes(Phase::Payload, transfer.payloadBytes());
+        std::cerr << "Communication for OT of keys (bytes, " << otBackendName(this->otBackend) << "): " << transfer.otBytes() << std::endl;
+        std::cerr << "Estimated communication for Contents (bytes): " << transfer.payloadBytes() << std::endl;
+        auto scope = this->metrics.measure(Phase::Matching);
+
+        // step 4. Bob should done evaluating by now. Receive fingerprints from him, packed FingerprintBits bits each (see FingerprintTable::pack).
+        std::vector<uint64_t> fingerprints;
+        cp::sync_wait(chl.recvResize(fingerprints));
+        std::cerr << "Estimated communication for Bob's fingerprints (bytes): " << fingerprints.size() * sizeof(uint64_t) << std::endl;
+        this->metrics.addBytes(Phase::Matching, fingerprints.size() * sizeof(uint64_t));
+
+        // step 5. look up the intersection between fingerprint of Alice's and Bob's, which yields result.
+        std::set<Point> intersections;
+        for (uint64_t pointIdx: table.match(fingerprints)) intersections.emplace(structure.points[pointIdx]);
+        return intersections;
+    }
+
+    template<typename OtSource>
+    void runClient(const std::vector<Point>& points, cp::Socket& chl, OtSource& ot) {
+        // First, we generate random sequence s
+        std::random_device dev; std::mt19937_64 rng(dev());
+        std::bitset<L> s = GetBitSequenceFromPRNG<L>(rng);
+
+        // Next, we perform OT to select the L half-shares from Alice. they arrive one repetition at a time, in the order
+        // Alice finishes encoding them, so we never hold all L of them and evaluation overlaps with Alice's encoding.
+        TwoChooseOne_StreamReceiver transfer = [&] {
+            auto scope = this->metrics.measure(Phase::Ot);
+            return TwoChooseOne_StreamReceiver(chl, s, ot);
+        }();
+        this->metrics.addBytes(Phase::Ot, transfer.otBytes());
+
+        // We evaluate each of our point against the L half-shares, yielding a FingerprintBits long "fingerprint" for each item of ours.
+        std::vector<Fingerprint> fps(points.size());
+        for (uint64_t received = 0; received < L; ++received) {
+            auto [idx, share] = [&] {
+                auto scope = this->metrics.measure(Phase::Payload);
+                return transfer.receive<Share>();
+            }();
+            this->metrics.noteShareBytes((conversion_tools::ShareBlocks<Share>::bitLength(share) + 7) / 8); // one at a time
+            auto scope = this->metrics.measure(Phase::Evaluation);
+            setFingerprintBits(idx, recipe().evaluateShare(share, points, this->threadCount), fps);
+        }
+        this->metrics.addBytes(Phase::Payload, transfer.payloadBytes());
+
+        // We transfer such fingerprints back to Alice. Bob's part is now complete.
+        auto scope = this->metrics.measure(Phase::Matching);
+        auto packed = FingerprintTable<FingerprintBits>::pack(fps);
+        this->metrics.addBytes(Phase::Matching, packed.size() * sizeof(uint64_t));
+        cp::sync_wait(chl.send(std::move(packed)));
+    }
+
+    // sets bits BitsPerRepetition * idx and up of every fingerprint from evaluateShare's output.
+    static void setFingerprintBits(uint64_t idx, const std::vector<uint8_t>& bits, std::vector<Fingerprint>& fps) {
+        for (uint64_t pointIdx = 0; pointIdx < fps.size(); ++pointIdx)
+            for (uint64_t bit = 0; bit < BitsPerRepetition; ++bit) fps[pointIdx][BitsPerRepetition * idx + bit] = (bits[pointIdx] >> bit) & 1;
+    }
 };
\ No newline at end of file
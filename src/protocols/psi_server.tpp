@@ -0,0 +1,222 @@
+#pragma once
+#include "common.tpp"
+#include "protocol.tpp"
+#include "thread_pool.tpp"
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <numeric>
+#include <optional>
+
+// long-lived server for many clients querying one (slowly changing) structure of Alice's, with any protocol deriving from
+// GRS22_L_infinity_protocol. it listens on a single address, and each client connection is a session served by one worker
+// of a pool. a session carries all phases of any number of queries, so a query costs no TCP setup and no base OTs.
+// work that does not depend on the query is done offline, ahead of it:
+// - precompute() fills a pool of prepared runs (shares and Alice's fingerprint table, see Protocol::prepare), shared by all
+//   sessions. a query that finds the pool empty encodes its shares on the fly.
+// - each session keeps a pool of random OTs with its client (see RandomOtSenderPool), filled when the client asks for it.
+// so online, a query only exchanges the choice correction, the encrypted shares and the fingerprints.
+// on the wire a session is a sequence of requests, each followed by what it asks for:
+// { 1 } a query (a protocol run), { 2, n } n more random OTs, { 0 } end of session. a session holds the random OTs of at most
+// setMaxPooledQueries queries; a request for more drops the session before any OT is run.
+template<typename Protocol>
+class PsiServer {
+public:
+    using Point = typename Protocol::Point;
+    using Structure = typename Protocol::Structure;
+    using Prepared = typename Protocol::Prepared;
+    // called from the worker serving sessionId once each of its queries is answered.
+    using ResultHandler = std::function<void(uint64_t sessionId, const std::set<Point>& intersection)>;
+
+    // @param workerCount   number of sessions served at once; further clients wait for a free worker.
+    PsiServer(const std::vector<Point>& centers, uint32_t radius, uint64_t workerCount_ = defaultThreadCount())
+        : workerCount(workerCount_) {
+        setStructure(centers, radius);
+    }
+
+    // replaces Alice's structure, and drops the runs prepared for the old one. queries already running finish on the old one.
+    void setStructure(const std::vector<Point>& centers, uint32_t radius) {
+        auto next = std::make_shared<const Structure>(Protocol::expand(centers, radius));
+        std::lock_guard<std::mutex> guard(structureLock);
+        structure = std::move(next);
+        prepared.clear();
+    }
+
+    // offline phase: prepares count more runs on the current structure, with all cores. can run while serving.
+    void precompute(uint64_t count) {
+        std::shared_ptr<const Structure> current = currentStructure();
+        Protocol psi;
+        for (uint64_t i = 0; i < count; ++i) {
+            Prepared run = psi.prepare(*current);
+            std::lock_guard<std::mutex> guard(structureLock);
+            if (structure != current) return; // structure changed meanwhile, these runs are of no use
+            prepared.emplace_back(current, std::move(run));
+        }
+    }
+
+    uint64_t preparedCount() {
+        std::lock_guard<std::mutex> guard(structureLock);
+        return prepared.size();
+    }
+
+    // options below take effect for sessions accepted afterwards. clients must use the same OT backend.
+    void setOtBackend(OtBackend otBackend_) { otBackend = otBackend_; }
+    // threads used to encode a single query. defaults to 1, as sessions already run in parallel.
+    void setThreadsPerQuery(uint64_t threadsPerQuery_) { threadsPerQuery = threadsPerQuery_; }
+    // bounds the random OTs a client can make the server compute and hold ahead of its queries.
+    void setMaxPooledQueries(uint64_t maxPooledQueries_) { maxPooledQueries = maxPooledQueries_; }
+    void setResultHandler(ResultHandler handler_) { handler = std::move(handler_); }
+
+    // accepts clients on address (e.g. "localhost:2400") until stop() is called, then returns once every session is closed.
+    void serve(const std::string& address_) {
+        address = address_;
+        cp::AsioAcceptor acceptor(address, cp::global_io_context());
+        ThreadPool pool(workerCount);
+        for (uint64_t sessionId = 0;; ++sessionId) {
+            cp::Socket chl = cp::sync_wait(acceptor.accept());
+            if (stopping) break;
+            pool.submit([this, chl, sessionId]() mutable { serveSession(sessionId, chl); });
+        }
+    }
+
+    // makes serve() return, from another thread.
+    void stop() {
+        stopping = true;
+        cp::Socket wakeUp = cp::asioConnect(address, false); // unblocks the pending accept
+    }
+
+    uint64_t queriesServed() const { return queries; }
+private:
+    std::shared_ptr<const Structure> currentStructure() {
+        std::lock_guard<std::mutex> guard(structureLock);
+        return structure;
+    }
+
+    void serveSession(uint64_t sessionId, cp::Socket& chl) {
+        try {
+            Protocol psi;
+            psi.setThreadCount(threadsPerQuery);
+            psi.setOtBackend(otBackend);
+            RandomOtSenderPool ots(otBackend);
+            std::vector<uint64_t> request;
+            while (true) {
+                cp::sync_wait(chl.recvResize(request));
+                if (request.empty() || request[0] == 0) break;
+                if (request[0] == 2) {
+                    const uint64_t capacity = maxPooledQueries * Protocol::Repetitions - ots.size();
+                    if (request.at(1) > capacity)
+                        throw std::length_error("client asked for " + std::to_string(request[1]) + " random OTs, " + std::to_string(capacity) + " more may be pooled");
+                    ots.fill(request[1], chl);
+                    continue;
+                }
+
+                // take a prepared run if there is one, otherwise encode now.
+                std::shared_ptr<const Structure> current;
+                std::optional<Prepared> run;
+                {
+                    std::lock_guard<std::mutex> guard(structureLock);
+                    current = structure;
+                    if (!prepared.empty()) {
+                        current = prepared.front().first;
+                        run.emplace(std::move(prepared.front().second));
+                        prepared.pop_front();
+                    }
+                }
+                auto intersection = run ? psi.RunServer(*current, std::move(*run), chl, ots) : psi.RunServer(*current, chl, ots);
+                ++queries;
+                if (handler) handler(sessionId, intersection);
+            }
+        } catch (const std::exception& e) {
+            std::cerr << "session " << sessionId << " dropped: " << e.what() << std::endl;
+        }
+    }
+
+    uint64_t workerCount, threadsPerQuery = 1, maxPooledQueries = 1024;
+    OtBackend otBackend = OtBackend::Iknp;
+    ResultHandler handler;
+    std::shared_ptr<const Structure> structure;
+    std::deque<std::pair<std::shared_ptr<const Structure>, Prepared>> prepared; // with the structure they are for, each used once
+    std::mutex structureLock;
+    std::string address;
+    std::atomic<bool> stopping = false;
+    std::atomic<uint64_t> queries = 0;
+};
+
+// client end of a PsiServer session: one connection and its pool of random OTs, used by every query.
+template<typename Protocol>
+class PsiClient {
+public:
+    using Point = typename Protocol::Point;
+
+    PsiClient(const std::string& address, OtBackend otBackend = OtBackend::Iknp)
+        : chl(cp::asioConnect(address, false)), ots(otBackend) {}
+
+    ~PsiClient() {
+        try {
+            cp::sync_wait(chl.send(std::vector<uint64_t>{ 0 }));
+        } catch (...) {} // server is gone already
+    }
+
+    // offline phase: runs the random OTs of the next queryCount queries now.
+    void precompute(uint64_t queryCount) {
+        cp::sync_wait(chl.send(std::vector<uint64_t>{ 2, queryCount * Protocol::Repetitions }));
+        ots.fill(queryCount * Protocol::Repetitions, chl);
+    }
+
+    // runs the OTs of this query first if precompute() did not.
+    void query(const std::vector<Point>& points) {
+        if (ots.size() < Protocol::Repetitions) precompute(1);
+        cp::sync_wait(chl.send(std::vector<uint64_t>{ 1 }));
+        psi.RunClient(points, chl, ots);
+    }
+
+    void setThreadCount(uint64_t threadCount) { psi.setThreadCount(threadCount); }
+private:
+    cp::Socket chl;
+    RandomOtReceiverPool ots;
+    Protocol psi;
+};
+
+// outcome of generateLoad. latency of a query is measured by its client, from the request until its fingerprints are sent.
+struct LoadReport {
+    uint64_t queries = 0;
+    double seconds = 0, queriesPerSecond = 0, meanLatencyMs = 0, p99LatencyMs = 0;
+};
+
+// local load generator: clientCount concurrent clients, each opening one session to the PsiServer at address and sending
+// queriesPerClient queries for points through it. with precomputeOts, clients run the random OTs of all their queries before
+// the first one, and only the online phase is timed.
+template<typename Protocol>
+LoadReport generateLoad(const std::string& address, const std::vector<typename Protocol::Point>& points, uint64_t clientCount,
+                        uint64_t queriesPerClient, OtBackend otBackend = OtBackend::Iknp, bool precomputeOts = false) {
+    using Clock = std::chrono::steady_clock;
+    std::vector<std::vector<double>> latencies(clientCount);
+    std::vector<Clock::time_point> begins(clientCount), ends(clientCount);
+
+    parallelFor(clientCount, clientCount, [&](uint64_t clientIdx) {
+        PsiClient<Protocol> client(address, otBackend);
+        client.setThreadCount(1);
+        if (precomputeOts) client.precompute(queriesPerClient);
+        begins[clientIdx] = Clock::now();
+        for (uint64_t q = 0; q < queriesPerClient; ++q) {
+            auto start = Clock::now();
+            client.query(points);
+            latencies[clientIdx].push_back(std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+        }
+        ends[clientIdx] = Clock::now();
+    });
+
+    LoadReport report;
+    std::vector<double> all;
+    for (auto& l: latencies) all.insert(all.end(), l.begin(), l.end());
+    if (all.empty()) return report;
+
+    report.seconds = std::chrono::duration<double>(*std::max_element(ends.begin(), ends.end()) - *std::min_element(begins.begin(), begins.end())).count();
+    std::sort(all.begin(), all.end());
+    report.queries = all.size();
+    report.queriesPerSecond = report.queries / report.seconds;
+    report.meanLatencyMs = std::accumulate(all.begin(), all.end(), 0.0) / all.size();
+    report.p99LatencyMs = all[(all.size() * 99 + 99) / 100 - 1];
+    return report;
+}
@@ -0,0 +1,94 @@
+#pragma once
+#include "common.tpp"
+// for abstract class of protocol
+#include "protocol.tpp"
+
+// for implementing protocol
+#include "bfss/xor_share.tpp"
+#include "fingerprint_table.tpp"
+#include "oblivious_transfer.tpp"
+
+using std::string;
+
+// GRS22's protocol, using xorshare + tt, over L-infinity norm.
+// usage condition: Alice's balls are globally axis disjoint, i.e. their projections onto X (and onto Y) are pairwise disjoint.
+// there is no spatial hash nor OKVS: a share is one truth table per axis over the whole domain, 2 * 2 ^ bitLength bits, so
+// encoding is a few passes over the axes, and much cheaper than spatialhash + tt in both time and communication when the
+// domain is not much larger than Alice's balls. Lambda and cellBitLength are unused, and kept for the common interface.
+// for role of server and client, see protocols/protocol.hpp; the steps shared by all recipes are in GRS22_recipe_protocol.
+template<int bitLength, int Lambda, int L, int cellBitLength>
+class xorshare_tt: public GRS22_recipe_protocol<xorshare_tt<bitLength, Lambda, L, cellBitLength>,
+        typename XorSharebFSS<bitLength, 1>::SecretShare, L, bitLength, Lambda, L, cellBitLength> {
+public:
+    using Point = std::pair<uint64_t, uint64_t>;
+    // 1 bit values: 0 inside Alice's balls, random outside. this gives one fingerprint bit per repetition, as in spatialhash + tt.
+    using Bfss = XorSharebFSS<bitLength, 1>;
+    using Share = typename Bfss::SecretShare;
+    using Base = GRS22_recipe_protocol<xorshare_tt, Share, L, bitLength, Lambda, L, cellBitLength>;
+    using typename Base::Structure;
+    using typename Base::SharePairs;
+    using Product = typename Bfss::Product;
+
+    // Alice's points as products X_i x Y_i (see XorSharebFSS): columns with the same set of Y coordinates go together, and
+    // since balls are axis disjoint, no Y coordinate may be in two products. throws std::invalid_argument otherwise, so an
+    // unsuitable structure is refused before anything is sent.
+    static std::vector<Product> products(const Structure& structure) {
+        std::map<uint64_t, std::vector<uint64_t>> columns; // x -> its y coordinates
+        for (auto [x, y]: structure.points) columns[x].push_back(y);
+        std::map<std::vector<uint64_t>, std::vector<uint64_t>> byColumn; // y coordinates -> the x having exactly them
+        for (auto& [x, ys]: columns) {
+            std::sort(ys.begin(), ys.end());
+            byColumn[ys].push_back(x);
+        }
+
+        std::vector<Product> ret;
+        std::set<uint64_t> usedY;
+        for (auto& [ys, xs]: byColumn) {
+            for (uint64_t y: ys) if (!usedY.insert(y).second) throw std::invalid_argument("xorshare_tt needs globally axis disjoint balls");
+            ret.emplace_back(xs, ys);
+        }
+        return ret;
+    }
+protected:
+    friend Base;
+
+    // shares always span the whole domain; the products are only computed to refuse an unsuitable structure early.
+    static uint64_t shareBits(const Structure& structure) {
+        products(structure);
+        return Bfss::ShareLength;
+    }
+
+    // step 1. Alice generate L copies of bFSS describing her structure, spread over threadCount threads, each with its own PRNG
+    // stream (see ParallelEncoder). onDone(trial, pair) is called with both shares of repetition trial once they are ready, see
+    // GRS22_recipe_protocol. fixed size shares need no arena.
+    void encodeShares(const Structure& structure, ShareArena*, const std::function<void(uint64_t, typename Base::SharePair&)>& onDone) {
+        const auto pieces = products(structure);
+        std::random_device dev;
+        std::array<uint64_t, L> seeds;
+        for (auto& seed: seeds) seed = ((uint64_t)dev() << 32) | dev();
+
+        parallelFor(L, this->threadCount, [&](uint64_t trial) {
+            std::mt19937_64 rng(seeds[trial]);
+            auto pair = std::make_unique<typename Base::SharePair>(Bfss().encodeProducts(pieces, rng)); // on the heap, as in ParallelEncoder
+            onDone(trial, *pair);
+        });
+    }
+
+    // step 3. We also generate fingerprint for every element of ours with randomly selected s.
+    std::bitset<L> aliceChoice() {
+        std::random_device dev; std::mt19937_64 rng(dev());
+        return GetBitSequenceFromPRNG<L>(rng);
+    }
+
+    // the fingerprint bit of every point at one repetition, evaluated on its half-share: two table lookups per point, spread
+    // over threads threads. see GRS22_recipe_protocol::setFingerprintBits.
+    std::vector<uint8_t> evaluateShare(const Share& share, const std::vector<Point>& points, uint64_t threads) {
+        const uint64_t ChunkSize = 4096;
+        std::vector<uint8_t> ret(points.size());
+        parallelFor((points.size() + ChunkSize - 1) / ChunkSize, threads, [&](uint64_t chunk) {
+            const uint64_t begin = chunk * ChunkSize, end = std::min<uint64_t>(points.size(), begin + ChunkSize);
+            for (uint64_t pointIdx = begin; pointIdx < end; ++pointIdx) ret[pointIdx] = Bfss::evaluate(share, points[pointIdx])[0];
+        });
+        return ret;
+    }
+};
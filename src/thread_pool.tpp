@@ -0,0 +1,94 @@
+#pragma once
+#include "common.tpp"
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <exception>
+#include <vector>
+#include <deque>
+#include <functional>
+#include <condition_variable>
+
+// number of worker threads to use when caller does not specify one.
+inline uint64_t defaultThreadCount() {
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// runs fn(taskIdx) for every taskIdx in [0, taskCount) over threadCount threads, and returns once all tasks are done.
+// tasks are claimed one at a time from a shared atomic cursor, so an idle worker always picks up the next pending task
+// and uneven tasks (e.g. OKVS encodes that need a retry) do not leave other workers waiting behind a static partition.
+// the first exception thrown by a task is rethrown here after all workers have joined.
+template<typename F>
+void parallelFor(uint64_t taskCount, uint64_t threadCount, F&& fn) {
+    threadCount = std::max<uint64_t>(1, std::min(threadCount, taskCount));
+    std::atomic<uint64_t> cursor = 0;
+    std::exception_ptr error;
+    std::mutex errorLock;
+
+    auto worker = [&]() {
+        for (uint64_t idx; (idx = cursor.fetch_add(1)) < taskCount;) {
+            try {
+                fn(idx);
+            } catch (...) {
+                std::lock_guard<std::mutex> guard(errorLock);
+                if (!error) error = std::current_exception();
+                cursor = taskCount; // stop handing out further tasks
+            }
+        }
+    };
+
+    if (threadCount == 1) worker(); // no need to spawn anything
+    else {
+        std::vector<std::thread> workers;
+        for (uint64_t i = 0; i < threadCount; ++i) workers.emplace_back(worker);
+        for (auto& t: workers) t.join();
+    }
+    if (error) std::rethrow_exception(error);
+}
+
+// fixed set of threadCount workers running submitted jobs in submission order, for work that arrives over time (e.g. client
+// connections of PsiServer) rather than as a known batch like parallelFor. the destructor finishes all submitted jobs first.
+// jobs must not throw; exceptions are the job's own business.
+class ThreadPool {
+public:
+    explicit ThreadPool(uint64_t threadCount = defaultThreadCount()) {
+        for (uint64_t i = 0; i < std::max<uint64_t>(1, threadCount); ++i) workers.emplace_back([this] { work(); });
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& t: workers) t.join();
+    }
+
+    void submit(std::function<void()> job) {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            jobs.push_back(std::move(job));
+        }
+        wake.notify_one();
+    }
+private:
+    void work() {
+        while (true) {
+            std::function<void()> job;
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                wake.wait(guard, [this] { return stopping || !jobs.empty(); });
+                if (jobs.empty()) return; // stopping, and nothing left to do
+                job = std::move(jobs.front());
+                jobs.pop_front();
+            }
+            job();
+        }
+    }
+
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> jobs;
+    std::mutex lock;
+    std::condition_variable wake;
+    bool stopping = false;
+};
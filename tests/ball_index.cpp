@@ -0,0 +1,42 @@
+#include <catch2/catch_test_macros.hpp>
+#include "common.tpp"
+#include "ball_index.tpp"
+
+// linear scan, same as GRS22_L_infinity_protocol::membership.
+static bool linearMembership(const std::vector<BallIndex::Point>& centers, uint64_t x, uint64_t y, uint64_t radius) {
+    for (auto [cx, cy]: centers)
+        if (std::max(std::abs((int64_t)cx - (int64_t)x), std::abs((int64_t)cy - (int64_t)y)) <= (int64_t)radius) return true;
+    return false;
+}
+
+TEST_CASE("ball index agrees with linear scan", "[ballindex]") {
+    std::random_device dev; std::mt19937_64 rng(dev());
+    const uint64_t domainSize = 128;
+    for (uint64_t radius: {0, 1, 3, 10}) {
+        // overlapping balls, and balls sticking out of the domain.
+        std::vector<BallIndex::Point> centers;
+        for (int i = 0; i < 30; ++i) centers.emplace_back(rng() % domainSize, rng() % domainSize);
+        centers.emplace_back(0, 0);
+        centers.emplace_back(domainSize - 1, domainSize - 1);
+
+        BallIndex index(centers, radius);
+        std::vector<BallIndex::Point> expected;
+        for (uint64_t x = 0; x < domainSize; ++x) {
+            for (uint64_t y = 0; y < domainSize; ++y) {
+                bool inside = linearMembership(centers, x, y, radius);
+                REQUIRE(index.contains(x, y) == inside);
+                if (inside) expected.emplace_back(x, y);
+            }
+        }
+        REQUIRE(index.expand(domainSize) == expected);
+    }
+}
+
+TEST_CASE("ball index expands large domain sparsely", "[ballindex]") {
+    // 2^30 x 2^30 domain could never be scanned; only the area of the balls is touched.
+    std::vector<BallIndex::Point> centers = { {1000, 1000}, {1005, 1000}, {1ull << 29, 7} };
+    auto points = BallIndex(centers, 4).expand(1ull << 30);
+    REQUIRE(points.size() == 14 * 9 + 9 * 9);
+    REQUIRE(std::is_sorted(points.begin(), points.end()));
+    REQUIRE(std::adjacent_find(points.begin(), points.end()) == points.end());
+}
@@ -0,0 +1,72 @@
+#include <catch2/catch_test_macros.hpp>
+#include "common.tpp"
+#include "bit_buffer.tpp"
+
+TEST_CASE("word level bit copy matches bit by bit copy", "[bitbuffer]") {
+    std::random_device dev; std::mt19937_64 rng(dev());
+    const uint64_t wordCount = 8;
+    for (int trial = 0; trial < 2000; ++trial) {
+        std::vector<uint64_t> src(wordCount), dst(wordCount);
+        for (auto& w: src) w = rng();
+        for (auto& w: dst) w = rng();
+        auto expected = dst;
+
+        uint64_t count = rng() % (64 * wordCount + 1);
+        uint64_t srcOffset = rng() % (64 * wordCount - count + 1);
+        uint64_t dstOffset = trial % 4 == 0 ? srcOffset / 64 * 64 : rng() % (64 * wordCount - count + 1); // also hit the aligned path
+        if (trial % 4 == 0) srcOffset = srcOffset / 64 * 64;
+        if (dstOffset + count > 64 * wordCount || srcOffset + count > 64 * wordCount) continue;
+
+        for (uint64_t i = 0; i < count; ++i) {
+            bool bit = (src[(srcOffset + i) / 64] >> ((srcOffset + i) % 64)) & 1;
+            uint64_t& word = expected[(dstOffset + i) / 64];
+            word = bit ? word | (1ull << ((dstOffset + i) % 64)) : word & ~(1ull << ((dstOffset + i) % 64));
+        }
+        copyBits(src.data(), srcOffset, dst.data(), dstOffset, count);
+        REQUIRE(dst == expected);
+    }
+}
+
+TEST_CASE("bitset words follow bit order and keep padding zero", "[bitbuffer]") {
+    std::bitset<130> bs;
+    bs[0] = bs[65] = bs[129] = 1;
+    const uint64_t* words = bitsetWords(bs);
+    REQUIRE(words[0] == 1);
+    REQUIRE(words[1] == 2);
+    REQUIRE(words[2] == 2);
+
+    BitBuffer buffer(300);
+    buffer.write(3, bs);
+    REQUIRE(buffer.read<130>(3) == bs);
+    REQUIRE(buffer.read<130>(3).count() == 3);
+    REQUIRE(buffer.blockCount() == 3);
+    REQUIRE(buffer.data()[4] == 0); // past size(), inside the padding
+}
+
+TEST_CASE("bit buffers from a share arena reuse its slots and move without copying", "[bitbuffer]") {
+    ShareArena arena(300, 2);
+    REQUIRE(arena.slotBytes() == 64);
+    REQUIRE(arena.capacityBytes() == 128);
+
+    BitBuffer a(300, &arena), b(300, &arena);
+    REQUIRE(reinterpret_cast<uintptr_t>(a.data()) % ShareArena::Alignment == 0);
+    REQUIRE_THROWS_AS(BitBuffer(300, &arena), std::bad_alloc); // bounded, does not grow
+    REQUIRE_NOTHROW(BitBuffer(1000)); // heap buffers are not limited by any arena
+    a.set(150, 1), a.set(299, 1);
+
+    const uint64_t* storage = a.data();
+    BitBuffer moved = std::move(a);
+    REQUIRE(moved.data() == storage);
+    REQUIRE(a.size() == 0);
+    REQUIRE(moved[299]);
+
+    BitBuffer copy = moved; // copies go to the heap
+    REQUIRE(copy.data() != storage);
+    REQUIRE(copy == moved);
+
+    moved = BitBuffer(); // gives the slot back
+    BitBuffer c(200, &arena);
+    REQUIRE(c.data() == storage);
+    REQUIRE(!c[150]); // storage is cleared for every new buffer
+    REQUIRE(arena.peakBytes() == 128);
+}
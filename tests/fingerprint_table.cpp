@@ -0,0 +1,63 @@
+#include <catch2/catch_test_macros.hpp>
+#include "common.tpp"
+#include "fingerprint_table.tpp"
+#include <chrono>
+
+TEST_CASE("fingerprint packing round trip", "[fingerprint]") {
+    std::random_device dev; std::mt19937_64 rng(dev());
+    std::vector<std::bitset<60>> fps(1001);
+    for (auto& fp: fps) fp = GetBitSequenceFromPRNG<60>(rng);
+
+    auto packed = FingerprintTable<60>::pack(fps);
+    REQUIRE(packed.size() == 1 + (1001 * 60 + 63) / 64); // 7.5 bytes per fingerprint, instead of a 16-byte block
+    auto keys = FingerprintTable<60>::unpack(packed);
+    REQUIRE(keys.size() == fps.size());
+    for (uint64_t i = 0; i < fps.size(); ++i) REQUIRE(keys[i][0] == bitsetWords(fps[i])[0]);
+
+    // truncated, empty, and a count so large that count * Bits wraps around.
+    packed.pop_back();
+    REQUIRE_THROWS_AS(FingerprintTable<60>::unpack(packed), std::invalid_argument);
+    REQUIRE_THROWS_AS(FingerprintTable<60>::unpack({}), std::invalid_argument);
+    REQUIRE_THROWS_AS(FingerprintTable<60>::unpack({ 307445734561825861ull, 0 }), std::invalid_argument); // * 60 = 2^64 + 44
+}
+
+TEST_CASE("fingerprint table matches and keeps colliding points", "[fingerprint]") {
+    std::random_device dev; std::mt19937_64 rng(dev());
+    using Table = FingerprintTable<130>; // spans three words
+    std::vector<std::bitset<130>> server(500);
+    for (auto& fp: server) fp = GetBitSequenceFromPRNG<130>(rng);
+    server[7] = server[3]; // two points share a fingerprint
+    server[8] = server[3];
+    server[20] = server[10];
+
+    Table table(server);
+    REQUIRE(table.size() == server.size());
+    REQUIRE(table.collisionCount() == 2);
+
+    // client holds some of ours (one of them twice), and some others.
+    std::vector<std::bitset<130>> client = { server[3], server[42], server[42], server[499], server[10] };
+    for (int i = 0; i < 100; ++i) client.push_back(GetBitSequenceFromPRNG<130>(rng));
+    std::shuffle(client.begin(), client.end(), rng);
+
+    auto matched = table.match(Table::pack(client));
+    REQUIRE(matched == std::vector<uint64_t>{3, 7, 8, 10, 20, 42, 499});
+}
+
+TEST_CASE("benchmark fingerprint matching", "[fingerprint][.benchmark]") {
+    const uint64_t n = 1000000;
+    using Clock = std::chrono::steady_clock;
+    std::mt19937_64 rng(1);
+    std::vector<std::bitset<60>> server(n), client(n);
+    for (auto& fp: server) fp = GetBitSequenceFromPRNG<60>(rng);
+    for (uint64_t i = 0; i < n; ++i) client[i] = i % 2 ? server[rng() % n] : GetBitSequenceFromPRNG<60>(rng);
+
+    auto begin = Clock::now();
+    FingerprintTable<60> table(server);
+    double build = std::chrono::duration<double>(Clock::now() - begin).count();
+    auto packed = FingerprintTable<60>::pack(client);
+    begin = Clock::now();
+    auto matched = table.match(packed);
+    double probe = std::chrono::duration<double>(Clock::now() - begin).count();
+    std::cout << n << " fingerprints: build " << build << "s, probe " << probe << "s, " << matched.size() << " matches, "
+              << packed.size() * sizeof(uint64_t) << " bytes on the wire" << std::endl;
+}
@@ -18,3 +18,41 @@ TEST_CASE("Solve linear system over binary field", "[solveLinear]") {
 
     std::cout << "Computed solution: " << val << std::endl;
 }
+
+TEST_CASE("Batched Gauss-Jordan agrees with per-column solveLinear", "[solveLinear]") {
+    const uint64_t M = 150, V = 70, n = 130;
+    std::random_device dev; std::mt19937_64 rng(dev());
+
+    std::vector<std::bitset<M>> A(n);
+    std::vector<std::bitset<V>> B(n);
+    for (auto& row: A) row = GetBitSequenceFromPRNG<M>(rng);
+    for (auto& row: B) row = GetBitSequenceFromPRNG<V>(rng);
+
+    auto X = solveLinearBatch<M, V>(A, B);
+    REQUIRE(X.has_value() == isFullRank<M>(A));
+    if (!X.has_value()) return; // rank deficient with probability ~2^-20, nothing more to check
+
+    // AX == B
+    for (uint64_t i = 0; i < n; ++i) {
+        std::bitset<V> acc;
+        for (uint64_t j = 0; j < M; ++j) if (A[i][j]) acc ^= X.value()[j];
+        REQUIRE(acc == B[i]);
+    }
+
+    // every column is also a solution found by the bit-by-bit solver
+    for (uint64_t col = 0; col < V; ++col) {
+        std::vector<bool> b(n);
+        for (uint64_t i = 0; i < n; ++i) b[i] = B[i][col];
+        REQUIRE(solveLinear<M>(A, b).has_value());
+    }
+}
+
+TEST_CASE("Batched Gauss-Jordan rejects dependent rows", "[solveLinear]") {
+    std::vector<std::bitset<4>> A = {std::bitset<4>("0110"), std::bitset<4>("1001"), std::bitset<4>("1111")};
+    std::vector<std::bitset<2>> B = {std::bitset<2>("01"), std::bitset<2>("10"), std::bitset<2>("11")};
+    REQUIRE_FALSE(solveLinearBatch<4, 2>(A, B).has_value());
+
+    A.pop_back(), B.pop_back();
+    auto X = solveLinearBatch<4, 2>(A, B);
+    REQUIRE(X.has_value());
+}
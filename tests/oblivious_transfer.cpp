@@ -1,29 +1,98 @@
 // modified from libOTe TODO courtesy
 #include <catch2/catch_test_macros.hpp>
+#include <catch2/catch_message.hpp>
 #include "common.tpp"
+#include <set>
+#include <chrono>
 #include "oblivious_transfer.tpp"
 #include <libOTe/TwoChooseOne/Iknp/IknpOtExtReceiver.h>
 #include <libOTe/TwoChooseOne/Iknp/IknpOtExtSender.h>
 
-TEST_CASE("AES encryption/decryption and serialisation of long message", "[cryptoTools]") {
-    const int messageLength = 1025;
-    const int packetCount = (messageLength + 127) / 128;
+template<int N>
+void checkBlockConversion(std::mt19937_64& rng) {
+    std::bitset<N> bs = GetBitSequenceFromPRNG<N>(rng);
+    auto blocks = conversion_tools::bsToBlocks<N>(bs);
+    for (uint64_t idx = 0; idx < (N + 127) / 128 * 128; ++idx) {
+        bool bit = (blocks[idx / 128].template get<uint64_t>((idx % 128) / 64) >> (idx % 64)) & 1;
+        REQUIRE(bit == (idx < N && bs[idx])); // bits past N are 0
+    }
+    REQUIRE(conversion_tools::blocksToBs<N>(blocks) == bs);
 
-    block key(12345, 67890);
-    // generate a random sequence of 1025 messageLength, so that we can test a sufficient long example that also reveal problem in endianness / not divisible case
-    
+    BitBuffer buffer(N);
+    buffer.write(0, bs);
+    std::vector<block> viaBuffer(buffer.blockCount());
+    conversion_tools::ShareBlocks<BitBuffer>::writeBlocks(buffer, viaBuffer.data());
+    REQUIRE(std::equal(viaBuffer.begin(), viaBuffer.end(), blocks.begin()));
+    REQUIRE(conversion_tools::ShareBlocks<BitBuffer>::fromBlocks(viaBuffer.data(), N) == buffer);
+    REQUIRE(conversion_tools::ShareBlocks<std::bitset<N>>::fromBlocks(viaBuffer.data(), N) == bs);
+}
+
+TEST_CASE("block conversion round trip", "[cryptoTools]") {
     std::random_device dev; std::mt19937_64 rng(dev());
-    std::bitset<messageLength> bs = GetBitSequenceFromPRNG<messageLength>(rng);
-    // std::cout << "generated random sequence: " << bs << std::endl;
+    checkBlockConversion<1>(rng);
+    checkBlockConversion<64>(rng);
+    checkBlockConversion<65>(rng);
+    checkBlockConversion<128>(rng);
+    checkBlockConversion<129>(rng);
+    checkBlockConversion<1025>(rng);
+}
 
-    auto enc = aesEncrypt<packetCount>(conversion_tools::bsToBlocks<messageLength>(bs), key);
-    auto dec = conversion_tools::blocksToBs<messageLength>(aesDecrypt<packetCount>(enc, key));
-    
-    REQUIRE(dec == bs);
+TEST_CASE("benchmark block conversion throughput", "[cryptoTools][.benchmark]") {
+    const int N = 1 << 22; // 4 Mbit share
+    const int rounds = 100;
+    using Clock = std::chrono::steady_clock;
+    std::mt19937_64 rng(1);
+    auto bs = std::make_unique<std::bitset<N>>(GetBitSequenceFromPRNG<N>(rng));
+    auto blocks = std::make_unique<std::array<block, N / 128>>();
+
+    auto report = [&](const char* name, auto&& run) {
+        auto begin = Clock::now();
+        for (int r = 0; r < rounds; ++r) run();
+        double elapsed = std::chrono::duration<double>(Clock::now() - begin).count();
+        std::cout << name << ": " << (double)N / 8 * rounds / elapsed / 1e9 << " GB/s" << std::endl;
+    };
+    report("bsToBlocks", [&] { *blocks = conversion_tools::bsToBlocks<N>(*bs); });
+    report("blocksToBs", [&] { *bs = conversion_tools::blocksToBs<N>(*blocks); });
+}
+
+TEST_CASE("AES-CTR hybrid encryption of long message", "[cryptoTools]") {
+    const uint64_t blockCount = 1000; // more than one keystream chunk, and not a multiple of it
+    std::random_device dev; std::mt19937_64 rng(dev());
+    std::vector<block> plain(blockCount);
+    for (auto& b: plain) b = block(rng(), rng());
+
+    block key(12345, 67890);
+    auto data = plain;
+    aesCtrXor(data.data(), data.size(), key);
+    REQUIRE(data != plain);
+    aesCtrXor(data.data(), data.size(), key);
+    REQUIRE(data == plain);
+
+    aesCtrXor(data.data(), data.size(), key);
+    aesCtrXor(data.data(), data.size(), block(12345, 67891));
+    REQUIRE(data != plain);
+}
+
+TEST_CASE("benchmark hybrid encryption throughput", "[cryptoTools][.benchmark]") {
+    const int blockCount = 1 << 14; // 256 KB message
+    const int rounds = 200;
+    using Clock = std::chrono::steady_clock;
+    auto data = std::make_unique<std::array<block, blockCount>>();
+    for (int i = 0; i < blockCount; ++i) (*data)[i] = block(i, i);
+    block key(12345, 67890);
 
-    block key2(12345, 67891);
-    auto dec2 = conversion_tools::blocksToBs<messageLength>(aesDecrypt<packetCount>(enc, key2));
-    REQUIRE(dec2 != bs);
+    auto report = [&](const char* name, auto&& run) {
+        auto begin = Clock::now();
+        for (int r = 0; r < rounds; ++r) run();
+        double elapsed = std::chrono::duration<double>(Clock::now() - begin).count();
+        std::cout << name << ": " << (double)blockCount * sizeof(block) * rounds / elapsed / 1e9 << " GB/s" << std::endl;
+    };
+    // baseline only: how OT payloads were encrypted before aesCtrXor, a fresh key schedule and one ECB block at a time.
+    report("ECB, block by block", [&] {
+        details::AES<details::AESTypes::NI> aes(key);
+        for (auto& e: *data) e = aes.ecbEncBlock(e);
+    });
+    report("aesCtrXor (CTR, in place)", [&] { aesCtrXor(data->data(), blockCount, key); });
 }
 
 TEST_CASE("Oblivious Transfer Interface (long message)", "[libOTe]") {
@@ -38,7 +107,7 @@ TEST_CASE("Oblivious Transfer Interface (long message)", "[libOTe]") {
     auto randElem = [&]() {return GetBitSequenceFromPRNG<bitLength>(rng); };
 
     // init an random array
-    std::array<std::pair<Element, Element>, n> content;
+    std::vector<std::pair<Element, Element>> content(n);
     for (auto& [u, v]: content) u = randElem(), v = randElem();
 
     auto thrd = std::thread([&] {
@@ -46,7 +115,7 @@ TEST_CASE("Oblivious Transfer Interface (long message)", "[libOTe]") {
     });
 
     std::bitset<n> choice = GetBitSequenceFromPRNG<n>(rng);
-    std::array<Element, n> ret;
+    std::vector<Element> ret;
     CHECK_NOTHROW(ret = TwoChooseOne_Receiver<IknpOtExtSender, IknpOtExtReceiver, bitLength, n>(ip, choice));
     thrd.join();
 
@@ -54,4 +123,159 @@ TEST_CASE("Oblivious Transfer Interface (long message)", "[libOTe]") {
         std::cout << "oblivious transfer returned " << ret[idx] << std::endl;
         REQUIRE(ret[idx] == (choice[idx] ? content[idx].second : content[idx].first));
     }
-}
\ No newline at end of file
+}
+
+TEST_CASE("Oblivious Transfer Stream (out of order, runtime sized, every OT backend)", "[libOTe]") {
+    const int n = 8;
+
+    std::random_device dev; std::mt19937_64 rng(dev());
+    std::string ip = "localhost";
+
+    // messages of varying length, including ones that do not fill the last block.
+    std::array<std::pair<BitBuffer, BitBuffer>, n> content;
+    for (uint64_t idx = 0; idx < n; ++idx) {
+        content[idx] = { BitBuffer(100 * idx + 1), BitBuffer(300 * idx + 7) };
+        for (auto* msg: { &content[idx].first, &content[idx].second })
+            for (uint64_t i = 0; i < msg->size(); ++i) msg->set(i, rng() & 1);
+    }
+
+    for (OtBackend backend: availableOtBackends()) {
+        INFO("OT backend: " << otBackendName(backend));
+        auto thrd = std::thread([&] {
+            TwoChooseOne_StreamSender stream(ip, n, backend);
+            // send in reverse order, from two threads at once
+            std::thread other([&] { for (int idx = n - 1; idx >= 0; idx -= 2) stream.send(idx, content[idx].first, content[idx].second); });
+            for (int idx = n - 2; idx >= 0; idx -= 2) stream.send(idx, content[idx].first, content[idx].second);
+            other.join();
+        });
+
+        std::bitset<n> choice = GetBitSequenceFromPRNG<n>(rng);
+        TwoChooseOne_StreamReceiver stream(ip, choice, backend);
+        std::set<uint64_t> seen;
+        for (uint64_t received = 0; received < n; ++received) {
+            auto [idx, msg] = stream.receive<BitBuffer>();
+            REQUIRE(seen.emplace(idx).second);
+            REQUIRE(msg == (choice[idx] ? content[idx].second : content[idx].first));
+        }
+        thrd.join();
+    }
+}
+
+TEST_CASE("Oblivious Transfer Stream reuses base OTs of a connection", "[libOTe]") {
+    const int n = 16;
+    std::random_device dev; std::mt19937_64 rng(dev());
+    std::string ip = "localhost";
+
+    std::array<std::pair<std::bitset<200>, std::bitset<200>>, n> content;
+    for (auto& [m0, m1]: content) m0 = GetBitSequenceFromPRNG<200>(rng), m1 = GetBitSequenceFromPRNG<200>(rng);
+
+    // two transfers over the same connection; only the first one runs base OTs.
+    std::array<uint64_t, 2> sentOtBytes;
+    auto thrd = std::thread([&] {
+        cp::Socket chl = cp::asioConnect(ip + transferPort, true);
+        ReusableOtSender ot;
+        for (int round = 0; round < 2; ++round) {
+            TwoChooseOne_StreamSender stream(chl, n, ot);
+            for (int idx = 0; idx < n; ++idx) stream.send(idx, content[idx].first, content[idx].second);
+            sentOtBytes[round] = stream.otBytes();
+        }
+    });
+
+    cp::Socket chl = cp::asioConnect(ip + transferPort, false);
+    ReusableOtReceiver ot;
+    for (int round = 0; round < 2; ++round) {
+        std::bitset<n> choice = GetBitSequenceFromPRNG<n>(rng);
+        TwoChooseOne_StreamReceiver stream(chl, choice, ot);
+        for (int received = 0; received < n; ++received) {
+            auto [idx, msg] = stream.receive<std::bitset<200>>();
+            REQUIRE(msg == (choice[idx] ? content[idx].second : content[idx].first));
+        }
+    }
+    thrd.join();
+    REQUIRE(sentOtBytes[1] < sentOtBytes[0]);
+}
+
+TEST_CASE("Oblivious Transfer Stream from precomputed random OTs", "[libOTe]") {
+    const int n = 16;
+    std::random_device dev; std::mt19937_64 rng(dev());
+    std::string ip = "localhost";
+
+    std::array<std::pair<BitBuffer, BitBuffer>, n> content;
+    for (auto& [m0, m1]: content) {
+        m0 = BitBuffer(300), m1 = BitBuffer(300);
+        for (uint64_t i = 0; i < 300; ++i) m0.set(i, rng() & 1), m1.set(i, rng() & 1);
+    }
+
+    // random OTs of two transfers are run ahead, then each transfer only sends the n bit choice correction.
+    std::array<uint64_t, 2> onlineOtBytes;
+    uint64_t offlineOtBytes = 0, leftOver = 0;
+    auto thrd = std::thread([&] {
+        cp::Socket chl = cp::asioConnect(ip + transferPort, true);
+        RandomOtSenderPool pool;
+        pool.fill(2 * n, chl);
+        offlineOtBytes = pool.fillBytes();
+        for (int round = 0; round < 2; ++round) {
+            TwoChooseOne_StreamSender stream(chl, n, pool);
+            for (int idx = 0; idx < n; ++idx) stream.send(idx, content[idx].first, content[idx].second);
+            onlineOtBytes[round] = stream.otBytes();
+        }
+        leftOver = pool.size();
+    });
+
+    cp::Socket chl = cp::asioConnect(ip + transferPort, false);
+    RandomOtReceiverPool pool;
+    pool.fill(2 * n, chl);
+    for (int round = 0; round < 2; ++round) {
+        std::bitset<n> choice = GetBitSequenceFromPRNG<n>(rng);
+        TwoChooseOne_StreamReceiver stream(chl, choice, pool);
+        for (int received = 0; received < n; ++received) {
+            auto [idx, msg] = stream.receive<BitBuffer>();
+            REQUIRE(msg == (choice[idx] ? content[idx].second : content[idx].first));
+        }
+    }
+    CHECK_THROWS_AS(pool.take(1), std::out_of_range);
+    thrd.join();
+    REQUIRE(leftOver == 0);
+    for (uint64_t bytes: onlineOtBytes) REQUIRE(bytes < offlineOtBytes / 2);
+}
+
+TEST_CASE("Oblivious Transfer Stream refuses malformed chunks", "[libOTe]") {
+    const int n = 4;
+    std::string ip = "localhost";
+    auto thrd = std::thread([&] {
+        cp::Socket chl = cp::asioConnect(ip + transferPort, true);
+        RandomOtSenderPool pool;
+        pool.fill(n, chl);
+        TwoChooseOne_StreamSender stream(chl, n, pool);
+        // a chunk without its second header block, one of an index out of range, and one shorter than its lengths claim.
+        cp::sync_wait(chl.send(std::vector<block>{ block(0, 128) }));
+        cp::sync_wait(chl.send(std::vector<block>{ block(n, 128), block(0, 128), block(0, 0), block(0, 0) }));
+        cp::sync_wait(chl.send(std::vector<block>{ block(0, 128), block(0, 1ull << 63), block(0, 0), block(0, 0) }));
+    });
+
+    cp::Socket chl = cp::asioConnect(ip + transferPort, false);
+    RandomOtReceiverPool pool;
+    pool.fill(n, chl);
+    TwoChooseOne_StreamReceiver stream(chl, std::bitset<n>(), pool);
+    for (int chunk = 0; chunk < 3; ++chunk) REQUIRE_THROWS_AS(stream.receive<BitBuffer>(), std::runtime_error);
+    thrd.join();
+}
+
+TEST_CASE("Oblivious Transfer Stream refuses a short choice correction", "[libOTe]") {
+    const int n = 100;
+    std::string ip = "localhost";
+    bool threw = false;
+    auto thrd = std::thread([&] {
+        cp::Socket chl = cp::asioConnect(ip + transferPort, true);
+        RandomOtSenderPool pool;
+        pool.fill(n, chl);
+        try { TwoChooseOne_StreamSender stream(chl, n, pool); } catch (const std::runtime_error&) { threw = true; }
+    });
+
+    cp::Socket chl = cp::asioConnect(ip + transferPort, false);
+    RandomOtReceiverPool pool;
+    pool.fill(n, chl);
+    cp::sync_wait(chl.send(std::vector<uint64_t>{ 0 })); // one word, where n choices take two
+    thrd.join();
+    REQUIRE(threw);
+}
@@ -1,6 +1,7 @@
 #include <catch2/catch_test_macros.hpp>
 #include "common.tpp"
 #include "okvs.tpp"
+#include <chrono>
 
 TEST_CASE("okvs hashing looks correctly", "[okvs]") {
     auto randomSource = std::make_unique<std::random_device>();
@@ -27,6 +28,49 @@ TEST_CASE("okvs stream hash looks correctly", "[okvs]") { // TODO uncomment; com
     REQUIRE(ret == ret2);
 }
 
+TEST_CASE("okvs batched stream hash agrees with single hash", "[okvs]") {
+    const size_t keyLen = 140, saltLen = 40, outLen = 300; // more than one block in and out, not multiples of 64
+    std::mt19937_64 gen(42);
+    auto salt = GetBitSequenceFromPRNG<saltLen>(gen);
+    std::vector<std::bitset<keyLen>> keys(1000);
+    for (auto& key: keys) key = GetBitSequenceFromPRNG<keyLen>(gen);
+
+    std::vector<std::bitset<outLen>> batched(keys.size());
+    okvs::streamHashBatch<keyLen, saltLen, outLen>(keys.data(), keys.size(), salt, batched.data());
+    for (uint64_t k = 0; k < keys.size(); ++k) REQUIRE(batched[k] == okvs::streamHash<keyLen, saltLen, outLen>(keys[k], salt));
+
+    // every input and salt bit matters.
+    for (uint64_t bit = 0; bit < keyLen; ++bit) {
+        auto flipped = keys[0]; flipped.flip(bit);
+        REQUIRE(okvs::streamHash<keyLen, saltLen, outLen>(flipped, salt) != batched[0]);
+    }
+    for (uint64_t bit = 0; bit < saltLen; ++bit) {
+        auto flipped = salt; flipped.flip(bit);
+        REQUIRE(okvs::streamHash<keyLen, saltLen, outLen>(keys[0], flipped) != batched[0]);
+    }
+}
+
+TEST_CASE("benchmark okvs stream hash", "[okvs][.benchmark]") {
+    const size_t keyLen = 40, saltLen = 40;
+    const uint64_t n = 1000000;
+    using Clock = std::chrono::steady_clock;
+    std::mt19937_64 gen(42);
+    auto salt = GetBitSequenceFromPRNG<saltLen>(gen);
+    std::vector<std::bitset<keyLen>> keys(n);
+    for (auto& key: keys) key = GetBitSequenceFromPRNG<keyLen>(gen);
+
+    std::vector<std::bitset<128>> out(n);
+    auto begin = Clock::now();
+    okvs::streamHashBatch<keyLen, saltLen, 128>(keys.data(), n, salt, out.data());
+    double elapsed = std::chrono::duration<double>(Clock::now() - begin).count();
+    std::cout << "stream hash (batched, 128 bit rows): " << n / elapsed / 1e6 << " M keys/s" << std::endl;
+
+    begin = Clock::now();
+    for (uint64_t k = 0; k < n; ++k) out[k] = okvs::streamHash<keyLen, saltLen, 128>(keys[k], salt);
+    elapsed = std::chrono::duration<double>(Clock::now() - begin).count();
+    std::cout << "stream hash (one at a time, 128 bit rows): " << n / elapsed / 1e6 << " M keys/s" << std::endl;
+}
+
 TEST_CASE("reversibility of okvs encoding (large case)", "[okvs]") {
     auto randomSource = std::make_unique<std::random_device>();
     okvs::RandomBooleanPaXoS<6, 8, 2, 10> paxos(std::move(randomSource));
@@ -96,4 +140,176 @@ TEST_CASE("reversibility of okvs encoding (small case)", "[okvs]") {
     REQUIRE(decodeResult == Value("01"));
     REQUIRE(decode2 == Value("10"));
     // WARN(s.find(decode_wrong) != s.end()); // wrong key should decode into gibberish
-}
\ No newline at end of file
+}
+
+// encodes n random key-value pairs with the dense PaXoS, and compares against the previous encode path
+// (isFullRank followed by one bit-by-bit solveLinear per value column) on the same matrix.
+// legacy path is cubic per column, so it is skipped for large n.
+template<uint64_t n>
+void benchmarkDenseEncode(bool runLegacy) {
+    const uint64_t KeyLength = 32, ValueLength = 16, Lambda = n - KeyLength + 40; // 40 spare columns: full rank w.p. ~1 - 2^-40
+    const uint64_t HashedKeyLength = KeyLength + Lambda;
+    using Paxos = okvs::RandomBooleanPaXoS<KeyLength, ValueLength, Lambda>;
+    using Clock = std::chrono::steady_clock;
+
+    std::mt19937_64 rng(n);
+    std::vector<std::pair<std::bitset<KeyLength>, std::bitset<ValueLength>>> kvs;
+    for (uint64_t i = 0; i < n; ++i) kvs.emplace_back(i * 2654435761ull, rng());
+
+    Paxos paxos(std::make_unique<std::random_device>());
+    auto begin = Clock::now();
+    auto encoded = paxos.encode(kvs);
+    double batched = std::chrono::duration<double>(Clock::now() - begin).count();
+    REQUIRE(encoded.has_value());
+
+    std::cout << "n = " << n << ": batched encode " << batched << "s";
+    if (runLegacy) {
+        begin = Clock::now();
+        auto nonce = GetBitSequenceFromPRNG<Lambda>(rng);
+        std::vector<std::bitset<HashedKeyLength>> matrix;
+        for (auto& [key, value]: kvs) matrix.emplace_back(paxos.template streamHash<KeyLength, Lambda, HashedKeyLength>(key, nonce));
+        REQUIRE(isFullRank<HashedKeyLength>(matrix));
+        for (uint64_t col = 0; col < ValueLength; ++col) {
+            std::vector<bool> b(n);
+            for (uint64_t j = 0; j < n; ++j) b[j] = kvs[j].second[col];
+            REQUIRE(solveLinear<HashedKeyLength>(matrix, b).has_value());
+        }
+        double legacy = std::chrono::duration<double>(Clock::now() - begin).count();
+        std::cout << ", per-column encode " << legacy << "s, speedup " << legacy / batched << "x";
+    }
+    std::cout << std::endl;
+}
+
+// dense PaXoS needs an n x (n + Lambda) matrix, so n = 100k would need >1GB just for the matrix;
+// large n is covered by the sparse backends instead.
+TEST_CASE("benchmark dense okvs encode", "[okvs][.benchmark]") {
+    benchmarkDenseEncode<100>(true);
+    benchmarkDenseEncode<1000>(true);
+    benchmarkDenseEncode<10000>(false);
+}
+
+TEST_CASE("band okvs decodes the same values as dense okvs", "[okvs]") {
+    const uint64_t KeyLength = 20, ValueLength = 16, Lambda = 40, n = 50;
+    using Key = std::bitset<KeyLength>;
+    using Value = std::bitset<ValueLength>;
+
+    std::random_device dev; std::mt19937_64 rng(dev());
+    std::map<uint64_t, Value> plain; // distinct keys
+    while (plain.size() < n) plain[rng() % (1ull << KeyLength)] = GetBitSequenceFromPRNG<ValueLength>(rng);
+    std::vector<std::pair<Key, Value>> kvs;
+    for (auto& [k, v]: plain) kvs.emplace_back(Key(k), v);
+
+    okvs::RandomBooleanPaXoS<KeyLength, ValueLength, Lambda> dense(std::make_unique<std::random_device>());
+    okvs::RandomBandPaXoS<KeyLength, ValueLength, Lambda, okvs::BandBackend<n>::Rows> band(std::make_unique<std::random_device>());
+
+    auto denseResult = dense.encode(kvs);
+    auto bandResult = band.encode(kvs);
+    REQUIRE(denseResult.has_value());
+    REQUIRE(bandResult.has_value());
+
+    // also goes through serialisation, since that is what SpatialHash transfers.
+    auto [denseEncoded, denseNonce] = dense.deserialize(dense.serialize(denseResult).value());
+    auto [bandEncoded, bandNonce] = band.deserialize(band.serialize(bandResult).value());
+    for (auto& [key, value]: kvs) {
+        auto fromDense = dense.decode(denseEncoded, denseNonce, key);
+        auto fromBand = band.decode(bandEncoded, bandNonce, key);
+        REQUIRE(fromDense == value);
+        REQUIRE(fromBand == fromDense);
+    }
+}
+
+TEST_CASE("okvs serialisation round trip keeps layout", "[okvs]") {
+    // value length and nonce length not multiple of 64, so rows straddle words.
+    const uint64_t KeyLength = 12, ValueLength = 37, Lambda = 40;
+    using Band = okvs::RandomBandPaXoS<KeyLength, ValueLength, Lambda, 0>;
+    std::random_device dev; std::mt19937_64 rng(dev());
+
+    Band::EncodedPaXoS rows(Band::rowsFor(100));
+    for (auto& row: rows) row = GetBitSequenceFromPRNG<ValueLength>(rng);
+    auto nonce = GetBitSequenceFromPRNG<Lambda>(rng);
+
+    Band paxos(1234);
+    auto serialised = paxos.serialize(std::make_pair(rows, nonce)).value();
+    REQUIRE(serialised.size() == ValueLength * rows.size() + Lambda);
+    for (uint64_t i = 0; i < rows.size(); ++i)
+        for (uint64_t bit = 0; bit < ValueLength; ++bit) REQUIRE(serialised[i * ValueLength + bit] == rows[i][bit]);
+    for (uint64_t bit = 0; bit < Lambda; ++bit) REQUIRE(serialised[ValueLength * rows.size() + bit] == nonce[bit]);
+
+    auto [restoredRows, restoredNonce] = paxos.deserialize(serialised);
+    REQUIRE(restoredRows == rows);
+    REQUIRE(restoredNonce == nonce);
+
+    // fixed size variant shares the layout.
+    using FixedBand = okvs::RandomBandPaXoS<KeyLength, ValueLength, Lambda, 100>;
+    FixedBand fixed(1234);
+    FixedBand::EncodedPaXoS fixedRows(rows.begin(), rows.begin() + 100);
+    auto fixedSerialised = fixed.serialize(std::make_pair(fixedRows, nonce)).value();
+    for (uint64_t bit = 0; bit < ValueLength * 100; ++bit) REQUIRE(fixedSerialised[bit] == serialised[bit]);
+    REQUIRE(fixed.deserialize(fixedSerialised).first == fixedRows);
+}
+
+TEST_CASE("band okvs holds more keys than key bit length", "[okvs]") {
+    const uint64_t KeyLength = 16, ValueLength = 8, Lambda = 40, n = 20000;
+    using Key = std::bitset<KeyLength>;
+    using Value = std::bitset<ValueLength>;
+
+    std::mt19937_64 rng(n);
+    std::vector<std::pair<Key, Value>> kvs;
+    for (uint64_t i = 0; i < n; ++i) kvs.emplace_back(Key(i), Value(rng()));
+
+    okvs::RandomBandPaXoS<KeyLength, ValueLength, Lambda, okvs::BandBackend<n>::Rows> band(std::make_unique<std::random_device>());
+    auto result = band.encode(kvs);
+    REQUIRE(result.has_value());
+    auto& [encoded, nonce] = result.value();
+    for (auto& [key, value]: kvs) REQUIRE(band.decode(encoded, nonce, key) == value);
+}
+
+TEST_CASE("benchmark band okvs encode", "[okvs][.benchmark]") {
+    const uint64_t KeyLength = 40, ValueLength = 16, Lambda = 40, n = 1000000;
+    using Key = std::bitset<KeyLength>;
+    using Value = std::bitset<ValueLength>;
+    using Clock = std::chrono::steady_clock;
+
+    std::mt19937_64 rng(n);
+    std::vector<std::pair<Key, Value>> kvs;
+    for (uint64_t i = 0; i < n; ++i) kvs.emplace_back(Key(i * 2654435761ull), Value(rng()));
+
+    okvs::RandomBandPaXoS<KeyLength, ValueLength, Lambda, okvs::BandBackend<n>::Rows> band(std::make_unique<std::random_device>());
+    auto begin = Clock::now();
+    auto result = band.encode(kvs);
+    double encodeTime = std::chrono::duration<double>(Clock::now() - begin).count();
+    REQUIRE(result.has_value());
+
+    auto& [encoded, nonce] = result.value();
+    begin = Clock::now();
+    for (auto& [key, value]: kvs) REQUIRE(band.decode(encoded, nonce, key) == value);
+    double decodeTime = std::chrono::duration<double>(Clock::now() - begin).count();
+    std::cout << "n = " << n << ": band encode " << encodeTime << "s, decode all " << decodeTime << "s" << std::endl;
+}
+
+TEST_CASE("sized band okvs length scales with number of keys", "[okvs]") {
+    const uint64_t KeyLength = 30, ValueLength = 16, Lambda = 40;
+    using Paxos = okvs::RandomBandPaXoS<KeyLength, ValueLength, Lambda, 0>;
+    using Key = std::bitset<KeyLength>;
+    using Value = std::bitset<ValueLength>;
+    std::mt19937_64 rng(42);
+
+    for (uint64_t n: {1, 10, 1000, 5000}) {
+        std::vector<std::pair<Key, Value>> kvs;
+        for (uint64_t i = 0; i < n; ++i) kvs.emplace_back(Key(i * 7919), Value(rng()));
+
+        Paxos paxos(std::make_unique<std::random_device>());
+        auto serialised = paxos.serialize(paxos.encode(kvs));
+        REQUIRE(serialised.has_value());
+        REQUIRE(serialised->size() == Paxos::serialisedLengthFor(n));
+        REQUIRE(serialised->size() <= ValueLength * (n + n / 5 + 65) + Lambda); // well below (1 + 20%) n rows
+
+        auto [encoded, nonce] = paxos.deserialize(serialised.value());
+        for (auto& [key, value]: kvs) REQUIRE(paxos.decode(encoded, nonce, key) == value);
+    }
+
+    // shorter than the nonce, fewer rows than a band, and not a whole number of rows.
+    Paxos paxos(1);
+    for (uint64_t bits: { Lambda - 1, Lambda + ValueLength * (Paxos::BandWidth - 1), Paxos::serialisedLengthFor(10) + 1 })
+        REQUIRE_THROWS_AS(paxos.deserialize(BitBuffer(bits)), std::invalid_argument);
+}
@@ -0,0 +1,65 @@
+#include <catch2/catch_test_macros.hpp>
+#include "bfss/parallel_encoder.tpp"
+#include "bfss/spatial_hash.tpp"
+#include "bfss/trivial_bfss.tpp"
+
+// a toy structure: cellCount cells, each a truth table secret-shared between h0 and h1.
+template<typename SuitableSpatialHash, uint64_t cellCount>
+auto buildCells() {
+    return [](uint64_t trial, std::mt19937_64& rng, SuitableSpatialHash& h0, SuitableSpatialHash& h1) {
+        for (uint32_t cell = 0; cell < cellCount; ++cell) {
+            TruthTable<2, 4> tt;
+            auto [share0, share1] = tt.encode({{cell % 4, std::bitset<4>(cell % 16)}}, rng);
+            h0.insert(cell, cell * 7, share0);
+            h1.insert(cell, cell * 7, share1);
+        }
+    };
+}
+
+TEST_CASE("parallel encoder yields valid shares independent of thread count", "[parallelencoder]") {
+    const uint64_t L = 6, cellCount = 200;
+    using SuitableSpatialHash = SpatialHash<12, 16, 40, okvs::SizedBandBackend<>>;
+    using Encoder = ParallelEncoder<SuitableSpatialHash, L>;
+
+    Encoder::SharePairs serial, parallel;
+    Encoder(1).encode(serial, buildCells<SuitableSpatialHash, cellCount>(), 1234);
+    Encoder(4).encode(parallel, buildCells<SuitableSpatialHash, cellCount>(), 1234);
+
+    SuitableSpatialHash decoder;
+    for (uint64_t trial = 0; trial < L; ++trial) {
+        REQUIRE(serial[trial] == parallel[trial]); // same master seed, same streams
+        for (uint32_t cell = 0; cell < cellCount; ++cell) {
+            TruthTable<2, 4> t0(decoder.decode(parallel[trial].first, cell, cell * 7));
+            TruthTable<2, 4> t1(decoder.decode(parallel[trial].second, cell, cell * 7));
+            REQUIRE((t0.evaluate(cell % 4) ^ t1.evaluate(cell % 4)) == std::bitset<4>(cell % 16));
+        }
+    }
+}
+
+TEST_CASE("parallel encoder propagates encoding failure", "[parallelencoder]") {
+    // dense OKVS holds at most 2 * 4 + 8 = 16 cells; 64 can never be encoded.
+    using SuitableSpatialHash = SpatialHash<4, 16, 8>;
+    auto build = [](uint64_t trial, std::mt19937_64& rng, SuitableSpatialHash& h0, SuitableSpatialHash& h1) {
+        for (uint32_t x = 0; x < 8; ++x) for (uint32_t y = 0; y < 8; ++y) h0.insert(x, y, rng()), h1.insert(x, y, rng());
+    };
+    ParallelEncoder<SuitableSpatialHash, 3>::SharePairs shares;
+    REQUIRE_THROWS(ParallelEncoder<SuitableSpatialHash, 3>(2).encode(shares, build));
+}
+
+TEST_CASE("benchmark parallel encoder speedup", "[parallelencoder][.benchmark]") {
+    const uint64_t L = 40, cellCount = 4000;
+    using SuitableSpatialHash = SpatialHash<12, 16, 40, okvs::SizedBandBackend<>>;
+    using Encoder = ParallelEncoder<SuitableSpatialHash, L>;
+    using Clock = std::chrono::steady_clock;
+
+    auto shares = std::make_unique<Encoder::SharePairs>();
+    double serialTime = 0;
+    for (uint64_t threads = 1; threads <= defaultThreadCount(); threads *= 2) {
+        auto begin = Clock::now();
+        Encoder(threads).encode(*shares, buildCells<SuitableSpatialHash, cellCount>());
+        double elapsed = std::chrono::duration<double>(Clock::now() - begin).count();
+        if (threads == 1) serialTime = elapsed;
+        std::cout << "L = " << L << ", " << cellCount << " cells, " << threads << " threads: "
+                  << elapsed << "s, speedup " << serialTime / elapsed << "x" << std::endl;
+    }
+}
@@ -0,0 +1,67 @@
+#include <catch2/catch_test_macros.hpp>
+#include "protocols/planner.tpp"
+#include "test_points.hpp"
+#include <set>
+#include <thread>
+
+namespace {
+    const int bitLength = 10, Lambda = 40, L = 60, MaxCellBitLength = 4;
+    using Planner = RecipePlanner<bitLength, Lambda, L, MaxCellBitLength>;
+    using Point = Planner::Point;
+
+    const Planner::Candidate& find(const std::vector<Planner::Candidate>& candidates, Recipe recipe, int cellBitLength) {
+        for (auto& candidate: candidates) if (candidate.recipe == recipe && candidate.cellBitLength == cellBitLength) return candidate;
+        FAIL("no such candidate");
+        return candidates.front();
+    }
+}
+
+TEST_CASE("planner only offers recipes fitting the structure", "[planner]") {
+    Planner planner;
+    const uint32_t radius = 4;
+
+    // balls on distinct rows and columns, far apart: everything fits.
+    auto candidates = planner.plan({ { 100, 300 }, { 300, 700 }, { 700, 100 } }, radius, 1000);
+    REQUIRE(candidates.size() == 1 + 2 * MaxCellBitLength);
+    for (auto& candidate: candidates) REQUIRE(candidate.feasible);
+    REQUIRE(find(candidates, Recipe::SpatialhashTt, 2).cells == 3 * 9); // 9 x 9 points over 3 x 3 cells of side 4, per ball
+
+    // two balls sharing their X range: xor-share can not describe them, and concat only while no cell holds parts of both.
+    candidates = planner.plan({ { 100, 100 }, { 102, 110 } }, radius, 1000);
+    REQUIRE_FALSE(find(candidates, Recipe::XorshareTt, 0).feasible);
+    REQUIRE(find(candidates, Recipe::SpatialhashConcatTt, 1).feasible);
+    REQUIRE_FALSE(find(candidates, Recipe::SpatialhashConcatTt, 4).feasible);
+    for (int cellBitLength = 1; cellBitLength <= MaxCellBitLength; ++cellBitLength)
+        REQUIRE(find(candidates, Recipe::SpatialhashTt, cellBitLength).feasible);
+    REQUIRE(planner.best(candidates).recipe != Recipe::XorshareTt);
+}
+
+TEST_CASE("planner picks, runs and predicts the bytes of a recipe", "[planner]") {
+    const uint32_t radius = 6;
+    std::vector<Point> centers = { { 40, 900 }, { 200, 40 }, { 500, 600 }, { 800, 300 } };
+    auto points = test_points::randomPoints(bitLength, 3000, 3);
+    for (auto [x, y]: centers) points.emplace_back(x - 1, y + 2); // make sure some are inside
+
+    for (bool axisDisjoint: { true, false }) {
+        if (!axisDisjoint) centers.emplace_back(45, 500); // shares rows with the first ball
+        Planner server, client;
+        auto Bob = std::thread([&] { client.SetIntersectionClient(points, "localhost"); });
+        auto intersection = server.SetIntersectionServer(centers, "localhost", radius);
+        Bob.join();
+
+        std::set<Point> groundtruth;
+        BallIndex balls(centers, radius);
+        for (auto [u, v]: points) if (balls.contains(u, v)) groundtruth.emplace(u, v);
+        REQUIRE(groundtruth.size() >= centers.size() - 1);
+        REQUIRE(groundtruth == intersection);
+
+        auto choice = server.lastChoice();
+        REQUIRE(client.lastChoice().recipe == choice.recipe);
+        REQUIRE(client.lastChoice().cellBitLength == choice.cellBitLength);
+        REQUIRE((choice.recipe == Recipe::XorshareTt) == axisDisjoint); // the domain is small, so xor-share is cheapest when it fits
+        // bytes are predicted exactly: they follow from share length and fingerprint width.
+        auto& metrics = server.instrumentation();
+        REQUIRE(choice.bytes == metrics[Phase::Payload].bytes + metrics[Phase::Matching].bytes);
+        REQUIRE(choice.seconds > 0);
+    }
+}
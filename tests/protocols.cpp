@@ -1,6 +1,8 @@
 #include <catch2/catch_test_macros.hpp>
 #include "protocols/spatialhash_concat_tt.tpp"
 #include "protocols/spatialhash_tt.tpp"
+#include "protocols/xorshare_tt.tpp"
+#include "test_points.hpp"
 
 TEST_CASE("soundness of spatialhash tt", "[protocol]") {
     const int bitLength = 8, Lambda = 200, L = 60, cellBitLength = 2;
@@ -134,4 +136,183 @@ TEST_CASE("soundness of spatialhash concat tt", "[protocol]") {
     dbg(groundtruth), dbg(intersection);
 
     REQUIRE(groundtruth == intersection);
-}
\ No newline at end of file
+}
+
+TEST_CASE("soundness of spatialhash tt (band okvs)", "[protocol]") {
+    // more balls than the dense OKVS could hold: 2 * (bitLength - cellBitLength) + Lambda = 52 cells at most.
+    const int bitLength = 8, Lambda = 40, L = 60, cellBitLength = 2;
+    const int aliceCount = 40, bobCount = 1000;
+    const int radius = 1 << cellBitLength;
+    using Backend = okvs::BandBackend<aliceCount * 9>; // a ball of radius 4 touches at most 3 x 3 cells of size 4
+
+    std::random_device rd;
+    const auto centers = test_points::randomPoints(bitLength, aliceCount, rd());
+    const auto points = test_points::randomPoints(bitLength, bobCount, rd());
+
+    auto Bob = std::thread([&] {
+        spatialhash_tt<bitLength, Lambda, L, cellBitLength, Backend> psi;
+        psi.SetIntersectionClient(points, "localhost");
+    });
+
+    spatialhash_tt<bitLength, Lambda, L, cellBitLength, Backend> psi;
+    auto intersection = psi.SetIntersectionServer(centers, "localhost", radius);
+
+    Bob.join();
+
+    const auto groundtruth = psi.plainIntersection(centers, radius, points);
+    REQUIRE(groundtruth == intersection);
+}
+
+TEST_CASE("soundness of spatialhash concat tt (sized band okvs)", "[protocol]") {
+    // share length follows the number of occupied cells; 16 balls touch up to 144 cells, more than the 2 * 6 + 40 a dense OKVS holds.
+    const int bitLength = 9, Lambda = 40, L = 60, cellBitLength = 3;
+    const int radius = 1 << cellBitLength;
+    using Backend = okvs::SizedBandBackend<>;
+
+    const auto centers = test_points::latticeCenters(bitLength, radius);
+    const auto points = test_points::randomPoints(bitLength, 1000, std::random_device()());
+
+    auto Bob = std::thread([&] {
+        spatialhash_concat_tt<bitLength, Lambda, L, cellBitLength, Backend> psi;
+        psi.SetIntersectionClient(points, "localhost");
+    });
+
+    spatialhash_concat_tt<bitLength, Lambda, L, cellBitLength, Backend> psi;
+    auto intersection = psi.SetIntersectionServer(centers, "localhost", radius);
+
+    Bob.join();
+
+    const auto groundtruth = psi.plainIntersection(centers, radius, points);
+    REQUIRE(groundtruth == intersection);
+}
+
+TEST_CASE("soundness of xorshare tt", "[protocol]") {
+    const int bitLength = 10, Lambda = 40, L = 60, cellBitLength = 3;
+    const int aliceCount = 20, bobCount = 10000;
+    const int radius = 6;
+    using Protocol = xorshare_tt<bitLength, Lambda, L, cellBitLength>;
+
+    // globally axis disjoint centers: a random permutation of distinct rows and columns, 2 * radius + 1 apart.
+    std::random_device rd;
+    std::mt19937 gen(rd());
+    std::vector<uint64_t> rows(aliceCount), columns(aliceCount);
+    for (int i = 0; i < aliceCount; ++i) rows[i] = columns[i] = radius + i * (2 * radius + 1 + 10);
+    std::shuffle(columns.begin(), columns.end(), gen);
+    std::vector<std::pair<uint64_t, uint64_t>> centers;
+    for (int i = 0; i < aliceCount; ++i) centers.emplace_back(rows[i], columns[i]);
+
+    auto points = test_points::randomPoints(bitLength, bobCount, gen());
+    for (auto [x, y]: centers) { // make sure some are inside
+        const std::pair<uint64_t, uint64_t> inside(x + 1, y - 2);
+        if (std::find(points.begin(), points.end(), inside) == points.end()) points.push_back(inside);
+    }
+
+    auto Bob = std::thread([&] {
+        Protocol psi;
+        psi.SetIntersectionClient(points, "localhost");
+    });
+
+    Protocol psi;
+    auto intersection = psi.SetIntersectionServer(centers, "localhost", radius);
+    Bob.join();
+
+    const auto groundtruth = psi.plainIntersection(centers, radius, points);
+    REQUIRE(groundtruth.size() >= aliceCount);
+    REQUIRE(groundtruth == intersection);
+
+    // balls sharing an X range can not be described by xor-share.
+    REQUIRE_THROWS_AS(Protocol::products(Protocol::expand({ { 20, 20 }, { 22, 100 } }, radius)), std::invalid_argument);
+}
+
+TEST_CASE("soundness of spatialhash concat tt (offline / online)", "[protocol]") {
+    // two queries over one connection, with random OTs run ahead: the first from a prepared run, the second encoding live.
+    const int bitLength = 9, Lambda = 40, L = 60, cellBitLength = 3;
+    const int radius = 1 << cellBitLength;
+    using Protocol = spatialhash_concat_tt<bitLength, Lambda, L, cellBitLength, okvs::SizedBandBackend<>>;
+
+    const auto centers = test_points::latticeCenters(bitLength, radius);
+    const auto points = test_points::randomPoints(bitLength, 1000, std::random_device()());
+
+    auto Bob = std::thread([&] {
+        cp::Socket chl = cp::asioConnect("localhost" + transferPort, false);
+        RandomOtReceiverPool ots;
+        ots.fill(2 * L, chl);
+        Protocol psi;
+        psi.RunClient(points, chl, ots);
+        psi.RunClient(points, chl, ots);
+    });
+
+    Protocol psi;
+    const auto structure = Protocol::expand(centers, radius);
+    auto prepared = psi.prepare(structure);
+    cp::Socket chl = cp::asioConnect("localhost" + transferPort, true);
+    RandomOtSenderPool ots;
+    ots.fill(2 * L, chl);
+    auto fromPrepared = psi.RunServer(structure, std::move(prepared), chl, ots);
+    auto live = psi.RunServer(structure, chl, ots);
+    Bob.join();
+    // the shares of a prepared run go to one client only: using it again is refused before anything is sent.
+    REQUIRE_THROWS_AS(psi.RunServer(structure, std::move(prepared), chl, ots), std::invalid_argument);
+
+    const auto groundtruth = psi.plainIntersection(centers, radius, points);
+    REQUIRE(groundtruth == fromPrepared);
+    REQUIRE(groundtruth == live);
+}
+
+TEST_CASE("instrumentation of a spatialhash concat tt run", "[protocol]") {
+    const int bitLength = 9, Lambda = 40, L = 60, cellBitLength = 3;
+    const int radius = 1 << cellBitLength;
+    using Protocol = spatialhash_concat_tt<bitLength, Lambda, L, cellBitLength, okvs::SizedBandBackend<>>;
+
+    std::vector<std::pair<uint64_t, uint64_t>> centers = { { 3 * radius, 3 * radius }, { 10 * radius, 10 * radius } };
+    std::vector<std::pair<uint64_t, uint64_t>> points = { { 3 * radius, 3 * radius }, { 1, 1 } };
+
+    Protocol client;
+    auto Bob = std::thread([&] { client.SetIntersectionClient(points, "localhost"); });
+    Protocol server;
+    server.SetIntersectionServer(centers, "localhost", radius);
+    Bob.join();
+
+    // both parties see the same traffic, phase by phase.
+    for (Phase phase: { Phase::Ot, Phase::Payload, Phase::Matching }) {
+        REQUIRE(server.instrumentation()[phase].bytes > 0);
+        REQUIRE(server.instrumentation()[phase].bytes == client.instrumentation()[phase].bytes);
+    }
+    REQUIRE(server.instrumentation()[Phase::StructureBuild].wallSeconds > 0);
+    REQUIRE(server.instrumentation()[Phase::Encode].wallSeconds > 0);
+    REQUIRE(client.instrumentation()[Phase::Evaluation].wallSeconds > 0);
+    REQUIRE(client.instrumentation()[Phase::StructureBuild].wallSeconds == 0);
+
+    server.resetInstrumentation();
+    REQUIRE(server.instrumentation().totalBytes() == 0);
+}
+
+TEST_CASE("share memory of spatialhash concat tt is bounded", "[protocol]") {
+    const int bitLength = 9, Lambda = 40, L = 60, cellBitLength = 3;
+    const int radius = 1 << cellBitLength;
+    using Protocol = spatialhash_concat_tt<bitLength, Lambda, L, cellBitLength, okvs::SizedBandBackend<>>;
+
+    std::vector<std::pair<uint64_t, uint64_t>> centers = { { 3 * radius, 3 * radius }, { 10 * radius, 10 * radius }, { 20 * radius, 5 * radius } };
+    std::vector<std::pair<uint64_t, uint64_t>> points = { { 3 * radius, 3 * radius }, { 20 * radius + 1, 5 * radius }, { 1, 1 } };
+    const uint64_t cellCount = Protocol::expand(centers, radius).pointsByCell.size();
+    const uint64_t slotBytes = ShareArena::slotBytesFor(Protocol::SuitableSpatialHash::getOutputSize(cellCount));
+
+    // streamed: with one thread, a single repetition (two shares) is held at a time.
+    Protocol client, server;
+    server.setThreadCount(1);
+    auto Bob = std::thread([&] { client.SetIntersectionClient(points, "localhost"); });
+    auto intersection = server.SetIntersectionServer(centers, "localhost", radius);
+    Bob.join();
+    REQUIRE(intersection == std::set<std::pair<uint64_t, uint64_t>>{ points[0], points[1] });
+    REQUIRE(server.instrumentation().shareBytes() == 2 * slotBytes);
+    REQUIRE(client.instrumentation().shareBytes() > 0);
+    REQUIRE(client.instrumentation().shareBytes() <= slotBytes);
+
+    // prepared runs keep all 2L shares, and refuse to go over the limit.
+    Protocol offline;
+    const auto structure = Protocol::expand(centers, radius);
+    offline.prepare(structure);
+    REQUIRE(offline.instrumentation().shareBytes() == 2 * L * slotBytes);
+    offline.setShareMemoryLimit(2 * L * slotBytes - 1);
+    REQUIRE_THROWS_AS(offline.prepare(structure), std::length_error);
+}
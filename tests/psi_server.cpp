@@ -0,0 +1,118 @@
+#include <catch2/catch_test_macros.hpp>
+#include "protocols/spatialhash_concat_tt.tpp"
+#include "protocols/psi_server.tpp"
+#include "test_points.hpp"
+#include <set>
+
+// same instance as the sized band soundness test in protocols.cpp.
+namespace {
+    const int bitLength = 9, Lambda = 40, L = 60, cellBitLength = 3;
+    const int radius = 1 << cellBitLength;
+    using Protocol = spatialhash_concat_tt<bitLength, Lambda, L, cellBitLength, okvs::SizedBandBackend<>>;
+    using Point = Protocol::Point;
+}
+
+TEST_CASE("psi server answers concurrent sessions of several queries", "[psi_server]") {
+    const std::string address = "localhost:2400";
+    const uint64_t clientCount = 3, queriesPerClient = 2;
+    auto centers = test_points::latticeCenters(bitLength, radius);
+    auto points = test_points::randomPoints(bitLength, 500, 7);
+
+    const auto groundtruth = Protocol::plainIntersection(centers, radius, points);
+
+    PsiServer<Protocol> server(centers, radius, 2); // fewer workers than clients, so one session has to wait
+    std::mutex resultLock;
+    std::vector<std::set<Point>> results;
+    server.setResultHandler([&](uint64_t, const std::set<Point>& intersection) {
+        std::lock_guard<std::mutex> guard(resultLock);
+        results.push_back(intersection);
+    });
+    std::thread serving([&] { server.serve(address); });
+
+    auto report = generateLoad<Protocol>(address, points, clientCount, queriesPerClient);
+    server.stop();
+    serving.join();
+
+    REQUIRE(report.queries == clientCount * queriesPerClient);
+    REQUIRE(server.queriesServed() == clientCount * queriesPerClient);
+    REQUIRE(results.size() == clientCount * queriesPerClient);
+    for (auto& intersection: results) REQUIRE(intersection == groundtruth);
+}
+
+TEST_CASE("psi server answers queries from precomputed material", "[psi_server]") {
+    const std::string address = "localhost:2402";
+    const uint64_t clientCount = 2, queriesPerClient = 3;
+    auto centers = test_points::latticeCenters(bitLength, radius);
+    auto points = test_points::randomPoints(bitLength, 500, 13);
+
+    const auto groundtruth = Protocol::plainIntersection(centers, radius, points);
+
+    // fewer prepared runs than queries, so the last ones encode on the fly.
+    PsiServer<Protocol> server(centers, radius, clientCount);
+    server.precompute(4);
+    REQUIRE(server.preparedCount() == 4);
+    std::mutex resultLock;
+    std::vector<std::set<Point>> results;
+    server.setResultHandler([&](uint64_t, const std::set<Point>& intersection) {
+        std::lock_guard<std::mutex> guard(resultLock);
+        results.push_back(intersection);
+    });
+    std::thread serving([&] { server.serve(address); });
+
+    auto report = generateLoad<Protocol>(address, points, clientCount, queriesPerClient, OtBackend::Iknp, true);
+    server.stop();
+    serving.join();
+
+    REQUIRE(report.queries == clientCount * queriesPerClient);
+    REQUIRE(server.preparedCount() == 0);
+    REQUIRE(results.size() == clientCount * queriesPerClient);
+    for (auto& intersection: results) REQUIRE(intersection == groundtruth);
+}
+
+TEST_CASE("psi server refuses to pool more random OTs than allowed", "[psi_server]") {
+    const std::string address = "localhost:2403";
+    auto centers = test_points::latticeCenters(bitLength, radius);
+    auto points = test_points::randomPoints(bitLength, 100, 17);
+
+    PsiServer<Protocol> server(centers, radius, 2);
+    server.setMaxPooledQueries(2);
+    std::thread serving([&] { server.serve(address); });
+
+    // a client within the limit is served.
+    {
+        PsiClient<Protocol> client(address);
+        client.precompute(2);
+        client.query(points);
+    }
+    // one asking for more is dropped before any OT is run, so it only sees the connection close.
+    {
+        cp::Socket chl = cp::asioConnect(address, false);
+        cp::sync_wait(chl.send(std::vector<uint64_t>{ 2, 3 * Protocol::Repetitions }));
+        std::vector<uint64_t> reply;
+        REQUIRE_THROWS(cp::sync_wait(chl.recvResize(reply)));
+    }
+    server.stop();
+    serving.join();
+    REQUIRE(server.queriesServed() == 1);
+}
+
+TEST_CASE("benchmark psi server under concurrent load", "[psi_server][.benchmark]") {
+    const std::string address = "localhost:2401";
+    const uint64_t queriesPerClient = 5;
+    auto centers = test_points::latticeCenters(bitLength, radius);
+    auto points = test_points::randomPoints(bitLength, 1000, 11);
+
+    for (bool offline: {false, true}) {
+        for (uint64_t clientCount: {1, 2, 4, 8}) {
+            PsiServer<Protocol> server(centers, radius);
+            if (offline) server.precompute(clientCount * queriesPerClient);
+            std::thread serving([&] { server.serve(address); });
+            auto report = generateLoad<Protocol>(address, points, clientCount, queriesPerClient, OtBackend::Iknp, offline);
+            server.stop();
+            serving.join();
+
+            std::cout << (offline ? "online only, " : "") << clientCount << " clients: " << report.queriesPerSecond
+                      << " queries/s, mean latency " << report.meanLatencyMs << " ms, p99 latency " << report.p99LatencyMs << " ms" << std::endl;
+        }
+    }
+}
@@ -1,5 +1,6 @@
 #include <catch2/catch_test_macros.hpp>
-#include "bfss/spatial_hash.tpp" 
+#include "bfss/spatial_hash.tpp"
+#include <chrono>
 
 TEST_CASE("Spatial Hash Soundness", "[spatialhash]") {
     SpatialHash<6, 3, 1> spatial_hasher;
@@ -13,3 +14,106 @@ TEST_CASE("Spatial Hash Soundness", "[spatialhash]") {
 
     REQUIRE(ret2 == std::bitset<3>(5));
 }
+
+TEST_CASE("Spatial Hash Soundness (band okvs)", "[spatialhash]") {
+    using Dense = SpatialHash<6, 3, 40>;
+    using Band = SpatialHash<6, 3, 40, okvs::BandBackend<100>>;
+    Dense dense;
+    Band band;
+    std::vector<std::tuple<uint32_t, uint32_t, uint64_t>> cells = {{12, 21, 5}, {0, 0, 7}, {63, 1, 2}, {5, 5, 0}};
+    for (auto [x, y, v]: cells) dense.insert(x, y, std::bitset<3>(v)), band.insert(x, y, std::bitset<3>(v));
+
+    auto denseShare = dense.encode();
+    auto bandShare = band.encode();
+    REQUIRE(denseShare != std::nullopt);
+    REQUIRE(bandShare != std::nullopt);
+
+    for (auto [x, y, v]: cells) {
+        REQUIRE(band.decode(bandShare.value(), x, y) == std::bitset<3>(v));
+        REQUIRE(band.decode(bandShare.value(), x, y) == dense.decode(denseShare.value(), x, y));
+    }
+}
+
+TEST_CASE("Spatial Hash share grows with occupied cells (sized band okvs)", "[spatialhash]") {
+    using Sized = SpatialHash<10, 4, 40, okvs::SizedBandBackend<>>;
+    STATIC_REQUIRE_FALSE(Sized::FixedOutputSize);
+
+    Sized few, many;
+    few.insert(1, 2, std::bitset<4>(3));
+    for (uint32_t x = 0; x < 40; ++x) for (uint32_t y = 0; y < 40; ++y) many.insert(x, y, std::bitset<4>(x ^ y));
+
+    auto fewShare = few.encode();
+    auto manyShare = many.encode();
+    REQUIRE(fewShare != std::nullopt);
+    REQUIRE(manyShare != std::nullopt);
+    REQUIRE(fewShare->size() == Sized::getOutputSize(1));
+    REQUIRE(manyShare->size() == Sized::getOutputSize(1600));
+
+    REQUIRE(few.decode(fewShare.value(), 1, 2) == std::bitset<4>(3));
+    for (uint32_t x = 0; x < 40; ++x) for (uint32_t y = 0; y < 40; ++y) REQUIRE(many.decode(manyShare.value(), x, y) == std::bitset<4>(x ^ y));
+}
+
+TEST_CASE("Spatial Hash keeps cells apart past 16 bit coordinates", "[spatialhash]") {
+    // with 20 bit coordinates a cell key takes 40 bits; x = 2^12 and x = 0 used to collide once packed into 32.
+    using Wide = SpatialHash<20, 4, 40, okvs::SizedBandBackend<>>;
+    std::vector<std::tuple<uint32_t, uint32_t, uint64_t>> cells = {{1 << 12, 5, 3}, {0, 5, 9}, {(1 << 20) - 1, 1 << 19, 6}, {1 << 19, (1 << 20) - 1, 12}};
+    Wide hash;
+    for (auto [x, y, v]: cells) hash.insert(x, y, std::bitset<4>(v));
+    REQUIRE(hash.size() == cells.size());
+
+    auto share = hash.encode();
+    REQUIRE(share != std::nullopt);
+    for (auto [x, y, v]: cells) REQUIRE(hash.decode(share.value(), x, y) == std::bitset<4>(v));
+}
+
+template<typename Hash>
+void checkBatchDecode() {
+    Hash hash;
+    for (uint32_t x = 0; x < 6; ++x) for (uint32_t y = 0; y < 6; ++y) hash.insert(x, y, std::bitset<16>(x * 8 + y)); // within dense capacity
+    auto share = hash.encode();
+    REQUIRE(share != std::nullopt);
+
+    // occupied cells and empty ones alike
+    std::vector<std::pair<uint32_t, uint32_t>> cells;
+    for (uint32_t x = 0; x < 12; ++x) for (uint32_t y = 0; y < 12; ++y) cells.emplace_back(x, y);
+    const typename Hash::Decoder decoder(share.value());
+    std::vector<typename Hash::Value> values;
+    decoder.decodeBatch(cells, values);
+    REQUIRE(values.size() == cells.size());
+    for (uint64_t i = 0; i < cells.size(); ++i) {
+        auto [x, y] = cells[i];
+        REQUIRE(values[i] == hash.decode(share.value(), x, y));
+        REQUIRE(values[i] == decoder.decode(x, y));
+        if (x < 6 && y < 6) REQUIRE(values[i] == std::bitset<16>(x * 8 + y));
+    }
+}
+
+TEST_CASE("Spatial Hash batch decode agrees with single decode", "[spatialhash]") {
+    checkBatchDecode<SpatialHash<5, 16, 40>>();
+    checkBatchDecode<SpatialHash<5, 16, 40, okvs::BandBackend<64>>>();
+    checkBatchDecode<SpatialHash<5, 16, 40, okvs::SizedBandBackend<>>>();
+}
+
+TEST_CASE("benchmark spatial hash batch decode", "[spatialhash][.benchmark]") {
+    using Hash = SpatialHash<10, 64, 40, okvs::SizedBandBackend<>>;
+    using Clock = std::chrono::steady_clock;
+    Hash hash;
+    std::mt19937_64 rng(1);
+    for (uint32_t i = 0; i < 4000; ++i) hash.insert(rng() % 1024, rng() % 1024, std::bitset<64>(rng()));
+    auto share = hash.encode().value();
+
+    std::vector<std::pair<uint32_t, uint32_t>> cells(10000);
+    for (auto& [x, y]: cells) x = rng() % 1024, y = rng() % 1024;
+
+    auto begin = Clock::now();
+    for (auto [x, y]: cells) hash.decode(share, x, y);
+    double single = std::chrono::duration<double>(Clock::now() - begin).count();
+
+    begin = Clock::now();
+    const Hash::Decoder decoder(share);
+    std::vector<Hash::Value> values;
+    decoder.decodeBatch(cells, values);
+    double batched = std::chrono::duration<double>(Clock::now() - begin).count();
+    std::cout << cells.size() << " points on one share: " << single << "s deserialising per point, "
+              << batched << "s with Decoder::decodeBatch" << std::endl;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+#include <random>
+#include <set>
+#include <utility>
+#include <vector>
+
+// point sets shared by the protocol tests, over a [0, 2^bitLength)^2 domain.
+namespace test_points {
+    using Point = std::pair<uint64_t, uint64_t>;
+
+    // centers on a lattice of step 15 * radius, far enough apart for concat (>= 4 * radius), all balls inside the domain.
+    inline std::vector<Point> latticeCenters(int bitLength, uint64_t radius) {
+        std::vector<Point> centers;
+        for (uint64_t x = 2 * radius; x + 2 * radius < (1ull << bitLength); x += 15 * radius)
+            for (uint64_t y = 2 * radius; y + 2 * radius < (1ull << bitLength); y += 15 * radius) centers.emplace_back(x, y);
+        return centers;
+    }
+
+    // count distinct points, uniform over the domain, in sorted order. the same seed gives the same points.
+    inline std::vector<Point> randomPoints(int bitLength, uint64_t count, uint64_t seed) {
+        std::mt19937 gen(seed);
+        std::uniform_int_distribution<int> distr(0, (1 << bitLength) - 1);
+        std::set<Point> pointSet;
+        while (pointSet.size() < count) pointSet.emplace(distr(gen), distr(gen));
+        return std::vector<Point>(pointSet.begin(), pointSet.end());
+    }
+}
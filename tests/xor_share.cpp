@@ -0,0 +1,48 @@
+#include <catch2/catch_test_macros.hpp>
+#include "bfss/xor_share.tpp"
+
+TEST_CASE("xor-share bFSS soundness", "[xorshare]") {
+    using Bfss = XorSharebFSS<4, 3>;
+    std::random_device dev; std::mt19937_64 rng(dev());
+    std::vector<std::pair<std::pair<uint64_t, uint64_t>, std::bitset<3>>> data = { { { 1, 2 }, 0b101 }, { { 3, 7 }, 0b010 }, { { 15, 0 }, 0b000 } };
+    auto [share0, share1] = Bfss().encode(data, rng);
+
+    Bfss decoder0(share0), decoder1(share1);
+    for (auto& [key, value]: data) REQUIRE((decoder0.evaluate(key) ^ decoder1.evaluate(key)) == value);
+    REQUIRE(Bfss::evaluate(share0, { 1, 2 }) == decoder0.evaluate({ 1, 2 }));
+}
+
+TEST_CASE("xor-share bFSS of axis disjoint products", "[xorshare]") {
+    // two boxes, [2, 4] x [8, 9] and [10, 11] x [1, 5]. with 8-bit values, a point outside reads 0 with probability 2 ^ -8.
+    using Bfss = XorSharebFSS<4, 8>;
+    std::random_device dev; std::mt19937_64 rng(dev());
+    std::vector<Bfss::Product> boxes = { { { 2, 3, 4 }, { 8, 9 } }, { { 10, 11 }, { 1, 2, 3, 4, 5 } } };
+
+    uint64_t falsePositives = 0;
+    for (int trial = 0; trial < 20; ++trial) {
+        auto [share0, share1] = Bfss().encodeProducts(boxes, rng);
+        for (uint64_t x = 0; x < 16; ++x) for (uint64_t y = 0; y < 16; ++y) {
+            bool inside = (x >= 2 && x <= 4 && y >= 8 && y <= 9) || (x >= 10 && x <= 11 && y >= 1 && y <= 5);
+            bool zero = (Bfss::evaluate(share0, { x, y }) ^ Bfss::evaluate(share1, { x, y })).none();
+            if (inside) REQUIRE(zero);
+            else falsePositives += zero;
+        }
+    }
+    REQUIRE(falsePositives < 20 * 256 / 32); // expected about 20 * 246 / 256
+}
+
+TEST_CASE("xor-share bFSS refuses sets that are not axis disjoint", "[xorshare]") {
+    using Bfss = XorSharebFSS<4, 1>;
+    std::mt19937_64 rng(42);
+    REQUIRE_THROWS_AS(Bfss().encodeProducts({ { { 1, 2 }, { 1 } }, { { 2, 3 }, { 5 } } }, rng), std::invalid_argument); // X overlaps
+    REQUIRE_THROWS_AS(Bfss().encodeProducts({ { { 1 }, { 16 } } }, rng), std::invalid_argument); // out of the domain
+}
+
+TEST_CASE("xor-share bFSS refuses to evaluate outside the domain", "[xorshare]") {
+    using Bfss = XorSharebFSS<4, 1>;
+    std::mt19937_64 rng(42);
+    auto [share0, share1] = Bfss().encodeProducts({ { { 1 }, { 2 } } }, rng);
+    REQUIRE_NOTHROW(Bfss::evaluate(share0, { 15, 15 }));
+    REQUIRE_THROWS_AS(Bfss::evaluate(share0, { 16, 0 }), std::out_of_range);
+    REQUIRE_THROWS_AS(Bfss(share1).evaluate({ 0, 1ull << 40 }), std::out_of_range);
+}